@@ -0,0 +1,106 @@
+#include "bench_config.h"
+
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef WITH_BOOST_PROGRAM_OPTIONS
+using namespace boost::program_options;
+#endif
+
+namespace bench {
+
+BenchConfig::BenchConfig(const std::string& p)
+	: Config(p),
+	  width(256), height(256), bands(64),
+	  endmembers(6),
+	  noise(0.01),
+	  smoothness(8.),
+	  seed(42),
+	  run("all"),
+	  threads("1,0"),
+	  repeat(3),
+	  output()
+{
+	#ifdef WITH_BOOST_PROGRAM_OPTIONS
+		initBoostOptions();
+	#endif // WITH_BOOST_PROGRAM_OPTIONS
+}
+
+// descriptions of configuration options
+namespace desc {
+DESC_OPT(width,
+		"Width of the synthetic image")
+DESC_OPT(height,
+		"Height of the synthetic image")
+DESC_OPT(bands,
+		"Number of spectral bands of the synthetic image")
+DESC_OPT(endmembers,
+		"Number of pure spectra mixed in the synthetic image")
+DESC_OPT(noise,
+		"Standard deviation of additive noise, relative to the value range")
+DESC_OPT(smoothness,
+		"Spatial smoothness of material regions (sigma in pixels)")
+DESC_OPT(seed,
+		"Seed value of random number generators")
+DESC_OPT(run,
+		"Benchmarks to run: comma separated names, all, micro or macro")
+DESC_OPT(threads,
+		"Comma separated thread counts to sweep, 0 means automatic")
+DESC_OPT(repeat,
+		"Number of timed runs per benchmark and thread count")
+DESC_OPT(output,
+		"Output file for JSON results (standard output if empty)")
+}
+
+#ifdef WITH_BOOST_PROGRAM_OPTIONS
+void BenchConfig::initBoostOptions() {
+	options.add_options()
+		BOOST_OPT(width)
+		BOOST_OPT(height)
+		BOOST_OPT(bands)
+		BOOST_OPT(endmembers)
+		BOOST_OPT(noise)
+		BOOST_OPT(smoothness)
+		BOOST_OPT(seed)
+		BOOST_OPT(run)
+		BOOST_OPT(threads)
+		BOOST_OPT(repeat)
+		(key("output,O"), value(&output)->default_value(output),
+		 desc::output)
+		;
+}
+#endif // WITH_BOOST_PROGRAM_OPTIONS
+
+std::vector<int> BenchConfig::threadCounts() const {
+	std::vector<int> ret;
+	std::stringstream s(threads);
+	std::string token;
+	while (std::getline(s, token, ','))
+		if (!token.empty())
+			ret.push_back(std::max(std::atoi(token.c_str()), 0));
+	if (ret.empty())
+		ret.push_back(0);
+	return ret;
+}
+
+std::string BenchConfig::getString() const {
+	std::stringstream s;
+	if (prefix_enabled)
+		s << "[" << prefix << "]" << std::endl;
+
+	COMMENT_OPT(s, width);
+	COMMENT_OPT(s, height);
+	COMMENT_OPT(s, bands);
+	COMMENT_OPT(s, endmembers);
+	COMMENT_OPT(s, noise);
+	COMMENT_OPT(s, smoothness);
+	COMMENT_OPT(s, seed);
+	COMMENT_OPT(s, run);
+	COMMENT_OPT(s, threads);
+	COMMENT_OPT(s, repeat);
+	COMMENT_OPT(s, output);
+	return s.str();
+}
+
+}
@@ -0,0 +1,53 @@
+#ifndef BENCH_CONFIG_H
+#define BENCH_CONFIG_H
+
+#include <vole_config.h>
+
+#include <string>
+#include <vector>
+
+namespace bench {
+
+/**
+ * Configuration parameters for the synthetic image and the benchmark runs
+ */
+class BenchConfig : public Config {
+public:
+	BenchConfig(const std::string& prefix = std::string());
+
+	virtual ~BenchConfig() {}
+
+	/// image size
+	int width, height, bands;
+	/// number of pure spectra mixed in the image
+	int endmembers;
+	/// standard deviation of additive noise, relative to the value range
+	double noise;
+	/// spatial smoothness of the abundance maps (gaussian sigma in pixels)
+	double smoothness;
+	/// random seed, the same seed always yields the same image
+	int seed;
+
+	/// comma separated benchmark names, or "all", "micro", "macro"
+	std::string run;
+	/// comma separated thread counts to sweep, 0 means automatic
+	std::string threads;
+	/// number of timed runs per benchmark and thread count
+	int repeat;
+	/// JSON output file (empty for standard output)
+	std::string output;
+
+	/// parsed thread counts
+	std::vector<int> threadCounts() const;
+
+	virtual std::string getString() const;
+
+protected:
+#ifdef WITH_BOOST_PROGRAM_OPTIONS
+	virtual void initBoostOptions();
+#endif // WITH_BOOST_PROGRAM_OPTIONS
+};
+
+}
+
+#endif // BENCH_CONFIG_H
@@ -0,0 +1,307 @@
+#include "bench_shell.h"
+#include "synthetic.h"
+
+#include <stopwatch.h>
+#include <preprocessing.h>
+#include <meanshift.h>
+#include <gensom.h>
+#include <graphseg.h>
+#include <sorting.h>
+
+#include <tbb/task_scheduler_init.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/concurrent_hash_map.h>
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace bench {
+
+/* sparse histogram like the one of the distribution view (gui/dist_view),
+   which cannot be used without Qt */
+struct BinKeyHashCompare {
+	size_t hash(const std::vector<unsigned char> &a) const
+	{
+		size_t seed = 1878709926690269970;
+		boost::hash_range(seed, a.begin(), a.end());
+		return seed;
+	}
+	bool equal(const std::vector<unsigned char> &a,
+			   const std::vector<unsigned char> &b) const
+	{
+		return a == b;
+	}
+};
+typedef tbb::concurrent_hash_map<std::vector<unsigned char>,
+		std::pair<float, multi_img::Pixel>, BinKeyHashCompare> BinMap;
+
+static size_t distBins(const multi_img &img, int nbins)
+{
+	BinMap bins;
+	multi_img::Value binsize = (img.maxval - img.minval) / nbins;
+	size_t npixels = img.width * img.height;
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, npixels),
+					  [&](const tbb::blocked_range<size_t> &r) {
+		std::vector<unsigned char> key(img.size());
+		for (size_t i = r.begin(); i != r.end(); ++i) {
+			const multi_img::Pixel &p = img.atIndex(i);
+			for (size_t d = 0; d < p.size(); ++d) {
+				int pos = (int)((p[d] - img.minval) / binsize);
+				key[d] = (unsigned char)std::max(std::min(pos, nbins - 1), 0);
+			}
+			BinMap::accessor acc;
+			if (bins.insert(acc, key))
+				acc->second.second.assign(p.size(), 0.f);
+			acc->second.first += 1.f;
+			std::transform(p.begin(), p.end(), acc->second.second.begin(),
+						   acc->second.second.begin(),
+						   std::plus<multi_img::Value>());
+		}
+	});
+	return bins.size();
+}
+
+/* weights of a 4-connected graph on img like in seg_graphs, repeated to at
+   least minEdges entries for a multi-million-edge sort */
+static std::vector<float> edgeWeights(const multi_img &img, size_t minEdges)
+{
+	std::vector<float> ret;
+	for (int y = 0; y < img.height; ++y) {
+		for (int x = 0; x < img.width; ++x) {
+			const multi_img::Pixel &p = img(y, x);
+			if (x + 1 < img.width)
+				ret.push_back(cv::norm(p, img(y, x + 1), cv::NORM_L1));
+			if (y + 1 < img.height)
+				ret.push_back(cv::norm(p, img(y + 1, x), cv::NORM_L1));
+		}
+	}
+	size_t n = ret.size();
+	for (size_t i = 0; n > 0 && ret.size() < minEdges; ++i)
+		ret.push_back(ret[i % n]);
+	return ret;
+}
+
+BenchShell::BenchShell()
+ : Command(
+		"bench",
+		config,
+		"Johannes Jordan",
+		"johannes.jordan@informatik.uni-erlangen.de")
+{}
+
+std::vector<BenchShell::Benchmark> BenchShell::benchmarks()
+{
+	std::vector<Benchmark> ret;
+	// copied into the benchmarks, which are run after this function returns
+	const multi_img *img = image.get();
+	const cv::Mat1b truth = this->truth;
+	const int seed = config.seed;
+
+	/* micro benchmarks */
+	ret.push_back(Benchmark("pixels", false, [=] {
+		multi_img copy(*img, true);
+		copy.rebuildPixels(false);
+	}));
+	ret.push_back(Benchmark("data_range", false, [=] {
+		img->data_range();
+	}));
+	ret.push_back(Benchmark("gradient", false, [=] {
+		img->spec_gradient();
+	}));
+	ret.push_back(Benchmark("preprocessing", false, [=] {
+		imginput::ImgInputConfig conf;
+		conf.normalize = true;
+		conf.gradient = true;
+		imginput::Preprocessing p(conf, *img,
+								  cv::Rect(0, 0, img->width, img->height),
+								  0, (int)img->size() - 1);
+		p.execute();
+	}));
+	ret.push_back(Benchmark("distbins", false, [=] {
+		distBins(*img, 64);
+	}));
+	const std::vector<float> weights = edgeWeights(*img, 1 << 22);
+	ret.push_back(Benchmark("edge_sort", false, [=] {
+		std::vector<float> w(weights);
+		std::vector<int> idx(w.size());
+		for (size_t i = 0; i < idx.size(); ++i)
+			idx[i] = i;
+		seg_graphs::sortRange(&w[0], &idx[0], w.size(), true);
+	}));
+	ret.push_back(Benchmark("edge_sort_std", false, [=] {
+		// comparison sort as previously used for edge ordering
+		std::vector<seg_graphs::Score> s(weights.size());
+		for (size_t i = 0; i < s.size(); ++i) {
+			seg_graphs::Score entry = { weights[i], (int)i };
+			s[i] = entry;
+		}
+		std::sort(s.begin(), s.end());
+	}));
+
+	/* macro benchmarks */
+	ret.push_back(Benchmark("fams", true, [=] {
+		seg_meanshift::MeanShiftConfig conf;
+		conf.seed = seed;
+		seg_meanshift::MeanShift(conf).execute(*img);
+	}));
+	ret.push_back(Benchmark("fams_unique", true, [=] {
+		seg_meanshift::MeanShiftConfig conf;
+		conf.seed = seed;
+		conf.unique = true;
+		seg_meanshift::MeanShift(conf).execute(*img);
+	}));
+	ret.push_back(Benchmark("fams_hierarchical", true, [=] {
+		seg_meanshift::MeanShiftConfig conf;
+		conf.seed = seed;
+		conf.coarseStep = 4;
+		seg_meanshift::MeanShift(conf).execute(*img);
+	}));
+	ret.push_back(Benchmark("som", true, [=] {
+		som::SOMConfig conf;
+		conf.seed = seed;
+		delete som::GenSOM::create(conf, *img);
+	}));
+	// sparse seeds taken from the ground truth
+	cv::Mat1b seeds(truth.size(), (uchar)0);
+	for (int y = 8; y < seeds.rows; y += 16)
+		for (int x = 8; x < seeds.cols; x += 16)
+			seeds(y, x) = truth(y, x) + 1;
+	ret.push_back(Benchmark("graphseg", true, [=] {
+		seg_graphs::GraphSegConfig conf;
+		conf.multi_seed = true;
+		seg_graphs::GraphSeg(conf).execute(*img, seeds);
+	}));
+	ret.push_back(Benchmark("graphseg_kruskal", true, [=] {
+		seg_graphs::GraphSegConfig conf;
+		conf.multi_seed = true;
+		conf.algo = seg_graphs::KRUSKAL;
+		seg_graphs::GraphSeg(conf).execute(*img, seeds);
+	}));
+	ret.push_back(Benchmark("graphseg_boruvka", true, [=] {
+		seg_graphs::GraphSegConfig conf;
+		conf.multi_seed = true;
+		conf.algo = seg_graphs::BORUVKA;
+		seg_graphs::GraphSeg(conf).execute(*img, seeds);
+	}));
+	return ret;
+}
+
+bool BenchShell::selected(const Benchmark &b) const
+{
+	std::stringstream s(config.run);
+	std::string token;
+	while (std::getline(s, token, ',')) {
+		if (token == "all" || token == b.name
+			|| (token == "micro" && !b.macro) || (token == "macro" && b.macro))
+			return true;
+	}
+	return false;
+}
+
+int BenchShell::execute() {
+	std::ofstream file;
+	if (!config.output.empty()) {
+		file.open(config.output.c_str());
+		if (!file.good()) {
+			std::cerr << "ERROR: Could not open output file: "
+					  << config.output << std::endl;
+			return -1;
+		}
+	}
+	std::ostream &out = (config.output.empty() ? std::cout : file);
+
+	// algorithms report progress on stdout, keep it clean for the results
+	std::streambuf *coutbuf = std::cout.rdbuf();
+	std::ostringstream discard;
+	if (config.output.empty())
+		std::cout.rdbuf(config.verbosity > 0 ? std::cerr.rdbuf()
+											 : discard.rdbuf());
+
+	Stopwatch watch;
+	Synthetic synthetic(config);
+	image = synthetic.execute();
+	truth = synthetic.groundTruth();
+	image->rebuildPixels(false);
+	double synthesis = watch.measure();
+
+	out << "{" << std::endl
+		<< "  \"image\": {\"width\": " << config.width
+		<< ", \"height\": " << config.height
+		<< ", \"bands\": " << config.bands
+		<< ", \"endmembers\": " << config.endmembers
+		<< ", \"noise\": " << config.noise
+		<< ", \"smoothness\": " << config.smoothness
+		<< ", \"seed\": " << config.seed
+		<< ", \"synthesis\": " << synthesis << "}," << std::endl
+		<< "  \"results\": [";
+
+	std::vector<int> threads = config.threadCounts();
+	std::vector<Benchmark> all = benchmarks();
+	bool first = true;
+	for (size_t i = 0; i < all.size(); ++i) {
+		const Benchmark &b = all[i];
+		if (!selected(b))
+			continue;
+		for (size_t t = 0; t < threads.size(); ++t) {
+			int nthreads = (threads[t] > 0 ? threads[t]
+						   : tbb::task_scheduler_init::default_num_threads());
+			tbb::task_scheduler_init init(nthreads);
+			if (config.verbosity > 0)
+				std::cerr << "bench: " << b.name << " with "
+						  << nthreads << " threads" << std::endl;
+
+			std::vector<double> times;
+			for (int r = 0; r < std::max(config.repeat, 1); ++r) {
+				watch.reset();
+				b.run();
+				times.push_back(watch.measure());
+			}
+			std::vector<double> sorted(times);
+			std::sort(sorted.begin(), sorted.end());
+			double mean = 0.;
+			for (size_t r = 0; r < times.size(); ++r)
+				mean += times[r];
+			mean /= times.size();
+
+			out << (first ? "" : ",") << std::endl
+				<< "    {\"name\": \"" << b.name << "\""
+				<< ", \"kind\": \"" << (b.macro ? "macro" : "micro") << "\""
+				<< ", \"threads\": " << nthreads
+				<< ", \"times\": [";
+			for (size_t r = 0; r < times.size(); ++r)
+				out << (r ? ", " : "") << times[r];
+			out << "], \"min\": " << sorted.front()
+				<< ", \"median\": " << sorted[sorted.size() / 2]
+				<< ", \"mean\": " << mean << "}";
+			out.flush();
+			first = false;
+		}
+	}
+	out << std::endl << "  ]" << std::endl << "}" << std::endl;
+
+	std::cout.rdbuf(coutbuf);
+	return 0;
+}
+
+void BenchShell::printShortHelp() const {
+	std::cout << "Benchmarks of the core algorithms on synthetic images" << std::endl;
+}
+
+void BenchShell::printHelp() const {
+	std::cout << "Benchmarks of the core algorithms on synthetic images" << std::endl;
+	std::cout << std::endl;
+	std::cout << "A deterministic image is generated from the given size, number of\n"
+	             "endmembers, noise level and smoothness. The selected benchmarks are\n"
+	             "run for each given thread count, timings (in seconds) are written\n"
+	             "as JSON. Micro benchmarks: pixels, data_range, gradient,\n"
+	             "preprocessing, distbins, edge_sort, edge_sort_std. Macro\n"
+	             "benchmarks: fams, fams_unique, fams_hierarchical, som, graphseg,\n"
+	             "graphseg_kruskal, graphseg_boruvka.";
+	std::cout << std::endl;
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef BENCH_SHELL_H
+#define BENCH_SHELL_H
+
+#include "bench_config.h"
+#include <command.h>
+#include <multi_img.h>
+
+#include <functional>
+
+namespace bench {
+
+/**
+ * Runs named benchmarks of the core kernels on a synthetic image.
+ *
+ * Micro benchmarks time single image operations, macro benchmarks whole
+ * segmentation or learning algorithms. Every benchmark is repeated for each
+ * thread count of the sweep, timings are written as JSON.
+ */
+class BenchShell : public shell::Command {
+public:
+	BenchShell();
+	int execute();
+
+	void printShortHelp() const;
+	void printHelp() const;
+
+protected:
+	struct Benchmark {
+		Benchmark(const std::string &name, bool macro,
+				  const std::function<void()> &run)
+			: name(name), macro(macro), run(run) {}
+		std::string name;
+		bool macro;
+		std::function<void()> run;
+	};
+
+	// all benchmarks, working on image and truth
+	std::vector<Benchmark> benchmarks();
+	// true if benchmark was requested in the configuration
+	bool selected(const Benchmark &b) const;
+
+	BenchConfig config;
+
+	multi_img::ptr image;
+	cv::Mat1b truth;
+};
+
+}
+
+#endif // BENCH_SHELL_H
@@ -0,0 +1,103 @@
+#include "synthetic.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <tbb/parallel_for.h>
+
+#include <cmath>
+
+namespace bench {
+
+std::vector<float> Synthetic::endmember(cv::RNG &rng) const
+{
+	std::vector<float> ret(config.bands, rng.uniform(0.05f, 0.2f));
+	for (int p = 0; p < 3; ++p) {
+		float center = rng.uniform(0.f, (float)config.bands);
+		float width = rng.uniform(0.05f, 0.3f) * config.bands;
+		float height = rng.uniform(0.1f, 0.6f);
+		for (int d = 0; d < config.bands; ++d) {
+			float x = (d - center) / width;
+			ret[d] += height * std::exp(-0.5f * x * x);
+		}
+	}
+	for (int d = 0; d < config.bands; ++d)
+		ret[d] = std::min(ret[d], 1.f);
+	return ret;
+}
+
+cv::Mat1f Synthetic::field(cv::RNG &rng) const
+{
+	cv::Mat1f ret(config.height, config.width);
+	rng.fill(ret, cv::RNG::UNIFORM, 0.f, 1.f);
+	if (config.smoothness > 0.)
+		cv::GaussianBlur(ret, ret, cv::Size(), config.smoothness);
+
+	cv::Scalar mean, stddev;
+	cv::meanStdDev(ret, mean, stddev);
+	ret = (ret - mean[0]) / std::max(stddev[0], 1e-6);
+	return ret;
+}
+
+multi_img::ptr Synthetic::execute()
+{
+	const int n = std::max(config.endmembers, 1);
+	cv::RNG rng(config.seed);
+
+	std::vector<std::vector<float> > spectra;
+	std::vector<cv::Mat1f> abundances;
+	for (int k = 0; k < n; ++k)
+		spectra.push_back(endmember(rng));
+	for (int k = 0; k < n; ++k)
+		abundances.push_back(field(rng));
+
+	/* abundances: softmax over the fields, which yields mostly pure regions
+	   with mixed pixels along their borders */
+	truth = cv::Mat1b(config.height, config.width, (uchar)0);
+	tbb::parallel_for(0, config.height, [&](int y) {
+		std::vector<float> a(n);
+		for (int x = 0; x < config.width; ++x) {
+			float sum = 0.f, best = 0.f;
+			for (int k = 0; k < n; ++k) {
+				a[k] = std::exp(3.f * abundances[k](y, x));
+				sum += a[k];
+				if (a[k] > best) {
+					best = a[k];
+					truth(y, x) = (uchar)k;
+				}
+			}
+			for (int k = 0; k < n; ++k)
+				abundances[k](y, x) = a[k] / sum;
+		}
+	});
+
+	multi_img::ptr ret(new multi_img(config.height, config.width,
+									 config.bands));
+	multi_img &img = *ret;
+	img.minval = MULTI_IMG_MIN_DEFAULT;
+	img.maxval = MULTI_IMG_MAX_DEFAULT;
+	const multi_img::Value range = img.maxval - img.minval;
+
+	/* bands are mixed independently, with noise seeded per band */
+	tbb::parallel_for(0, config.bands, [&](int d) {
+		multi_img::Band band(config.height, config.width, 0.f);
+		for (int k = 0; k < n; ++k)
+			cv::scaleAdd(abundances[k], spectra[k][d] * range, band, band);
+		if (config.noise > 0.) {
+			cv::RNG bandrng(config.seed + 7919 * (d + 1));
+			multi_img::Band noise(band.size());
+			bandrng.fill(noise, cv::RNG::NORMAL, 0., config.noise * range);
+			band += noise;
+		}
+		cv::max(band, img.minval, band);
+		cv::min(band, img.maxval, band);
+		img.setBand(d, band);
+	});
+
+	/* spectral range of a visible light camera */
+	for (int d = 0; d < config.bands; ++d)
+		img.meta[d] = multi_img::BandDesc(
+				400.f + 300.f * d / std::max(config.bands - 1, 1));
+
+	return ret;
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef BENCH_SYNTHETIC_H
+#define BENCH_SYNTHETIC_H
+
+#include "bench_config.h"
+#include <multi_img.h>
+
+namespace bench {
+
+/**
+ * Deterministic generator of hyperspectral test images.
+ *
+ * The image follows a linear mixing model: a number of smooth endmember
+ * spectra is mixed per pixel by abundance maps with spatially coherent
+ * regions, and gaussian noise is added. The same configuration always yields
+ * the same image, independent of the number of threads.
+ */
+class Synthetic {
+public:
+	Synthetic(const BenchConfig &config) : config(config) {}
+
+	/// generate the image
+	multi_img::ptr execute();
+
+	/// index of the dominant endmember of each pixel (after execute())
+	const cv::Mat1b& groundTruth() const { return truth; }
+
+protected:
+	// one random spectrum of sum of gaussian peaks in [0, 1]
+	std::vector<float> endmember(cv::RNG &rng) const;
+	// one smooth random field, normalized to zero mean and unit variance
+	cv::Mat1f field(cv::RNG &rng) const;
+
+	const BenchConfig &config;
+	cv::Mat1b truth;
+};
+
+}
+
+#endif // BENCH_SYNTHETIC_H
@@ -11,6 +11,7 @@
 //#define BACKGROUND_TASK_QUEUE_DEBUG
 
 #include "background_task_queue.h"
+#include <trace.h>
 #include <iostream>
 #include <iomanip>
 
@@ -98,7 +99,11 @@ void BackgroundTaskQueue::operator()()
 			if (!pop()) {
 				break; // Thread termination.
 			}
-			bool success = currentTask->run();
+			bool success;
+			{
+				TRACE_SPAN(typeid(*currentTask).name(), "task");
+				success = currentTask->run();
+			}
 			{
 				Lock lock(mutex);
 				currentTask->done(!cancelled && success);
@@ -1,6 +1,7 @@
 #include "band2qimagetbb.h"
 
 #include <tbb/parallel_for.h>
+#include <trace.h>
 
 bool Band2QImageTbb::run()
 {
@@ -26,6 +27,7 @@ bool Band2QImageTbb::run()
 
 void Band2QImage::operator()(const tbb::blocked_range2d<int> &r) const
 {
+	TRACE_SPAN("Band2QImage", "tbb");
 	multi_img::Value scale = 255.0 / (maxval - minval);
 	for (int y = r.rows().begin(); y != r.rows().end(); ++y) {
 		const multi_img::Value *srcrow = band[y];
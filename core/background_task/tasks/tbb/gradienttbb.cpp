@@ -54,39 +54,24 @@ bool GradientTbb::run()
 
 	Stopwatch s;
 
+	/* logarithm and differences in one pass, partitioned over blocks of
+	   bands and rows, without temporary images */
 	std::vector<cv::Rect>::iterator it;
-	multi_img temp((*source)->height, (*source)->width, (*source)->size());
 	for (it = calc.begin(); it != calc.end(); ++it) {
-		if (it->width > 0 && it->height > 0) {
-			multi_img srcScope(**source, *it);
-			multi_img tmpScope(temp, *it);
-			Log computeLog(srcScope, tmpScope);
-			tbb::parallel_for(tbb::blocked_range<size_t>(0, temp.size()),
-				computeLog, tbb::auto_partitioner(), stopper);
+		if (it->width > 0 && it->height > 0 && target->size() > 0) {
+			LogGrad computeLogGrad(**source, *target, *it);
+			tbb::parallel_for(tbb::blocked_range2d<int>(
+								  0, (int)target->size(), 8, 0, it->height, 16),
+				computeLogGrad, tbb::auto_partitioner(), stopper);
 		}
 
 		if (stopper.is_group_execution_cancelled())
 			break;
 	}
-	temp.minval = 0.;
-	temp.maxval = log((*source)->maxval);
-	temp.roi = (*source)->roi;
-
-	for (it = calc.begin(); it != calc.end(); ++it) {
-		if (it->width > 0 && it->height > 0) {
-			multi_img tmpScope(temp, *it);
-			multi_img tgtScope(*target, *it);
-			Grad computeGrad(tmpScope, tgtScope);
-			tbb::parallel_for(tbb::blocked_range<size_t>(0, target->size()),
-				computeGrad, tbb::auto_partitioner(), stopper);
-		}
-
-		if (stopper.is_group_execution_cancelled())
-			break;
-	}
-	target->minval = -temp.maxval;
-	target->maxval = temp.maxval;
-	target->roi = temp.roi;
+	multi_img::Value logmax = log((*source)->maxval);
+	target->minval = -logmax;
+	target->maxval = logmax;
+	target->roi = (*source)->roi;
 
 	// init multi_img::meta
 	for (unsigned int i = 0; i < (*source)->size()-1; ++i) {
@@ -1,46 +1,36 @@
 #include <shared_data.h>
 
-#include <tbb/task_group.h>
-#include <tbb/blocked_range.h>
-#include <tbb/blocked_range2d.h>
-#include <tbb/parallel_for.h>
-
-#include <stopwatch.h>
-
 #include <multi_img/illuminant.h>
-#include "multi_img/multi_img_tbb.h"
+#include <multi_img/multi_img_compact.h>
+#include <multi_img/multi_img_scaled.h>
 
 #include <background_task/background_task.h>
 #include "illuminanttbb.h"
 
-#define STOPWATCH_PRINT(stopwatch, message)
-
 bool IlluminantTbb::run()
 {
-	multi_img *source = &**multi;
-	assert(0 != source);
-	multi_img *target = new multi_img(source->height, source->width, source->size());
-	target->roi = source->roi;
-	target->meta = source->meta;
-	target->minval = source->minval;
-	target->maxval = source->maxval;
-
-	Stopwatch s;
-
-	Illumination computeIllumination(*source, *target, il, remove);
-	tbb::parallel_for(tbb::blocked_range<size_t>(0, target->size()),
-		computeIllumination, tbb::auto_partitioner(), stopper);
-
-	STOPWATCH_PRINT(s, "Illuminant TBB")
+	multi_img_base &source = multi->getBase();
+	std::vector<multi_img::Value> factors(source.size());
+	for (size_t d = 0; d < factors.size(); ++d) {
+		multi_img::Value factor = (multi_img::Value)il.at(source.meta[d].center);
+		factors[d] = (remove ? 1.f / factor : factor);
+	}
 
-	if (includecache) {
-		RebuildPixels rebuildPixels(*target);
-		tbb::parallel_for(tbb::blocked_range<size_t>(0, target->size()),
-			rebuildPixels, tbb::auto_partitioner(), stopper);
-		target->dirty.setTo(0);
-		target->anydirt = false;
+	/* factors are applied lazily on band access, band data is shared with
+	   the source and never copied here */
+	multi_img_base *target;
+	multi_img_compact *compact = dynamic_cast<multi_img_compact*>(&source);
+	multi_img_scaled *scaled = dynamic_cast<multi_img_scaled*>(&source);
+	if (compact) {
+		// folded into the quantization of each band
+		multi_img_compact *c = new multi_img_compact(*compact);
+		for (size_t d = 0; d < factors.size(); ++d)
+			c->scaleBand(d, factors[d]);
+		target = c;
+	} else if (scaled) {
+		target = new multi_img_scaled(*scaled, factors);
 	} else {
-		target->resetPixels();
+		target = new multi_img_scaled(**multi, factors);
 	}
 
 	if (stopper.is_group_execution_cancelled()) {
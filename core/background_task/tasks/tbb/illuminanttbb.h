@@ -1,12 +1,13 @@
 #ifndef ILLUMINANTTBB_H
 #define ILLUMINANTTBB_H
 
+/* applies illuminant as lazily evaluated per-band factors,
+   see multi_img_scaled */
 class IlluminantTbb : public BackgroundTask {
 public:
-	IlluminantTbb(SharedMultiImgPtr multi, const Illuminant& il, bool remove,
-		   bool includecache = true)
+	IlluminantTbb(SharedMultiImgPtr multi, const Illuminant& il, bool remove)
 		: BackgroundTask(), multi(multi),
-		il(il), remove(remove), includecache(includecache) {}
+		il(il), remove(remove) {}
 	virtual ~IlluminantTbb() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
@@ -16,6 +17,5 @@ protected:
 	SharedMultiImgPtr multi;
 	Illuminant il;
 	bool remove;
-	bool includecache;
 };
 #endif // ILLUMINANTTBB_H
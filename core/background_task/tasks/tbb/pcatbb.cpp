@@ -1,49 +1,43 @@
 #include <shared_data.h>
 
 #include <tbb/blocked_range.h>
-#include <tbb/blocked_range2d.h>
 #include <tbb/parallel_for.h>
-#include <tbb/parallel_reduce.h>
 
 #include "multi_img/multi_img_tbb.h"
+#include "multi_img/bandpca.h"
 #include <background_task/background_task.h>
 #include "pcatbb.h"
 
 bool PcaTbb::run()
 {
-	cv::Mat_<multi_img::Value> pixels(
-		(*source)->size(), (*source)->width * (*source)->height);
-	MultiImg2BandMat computePixels(**source, pixels);
-	tbb::parallel_for(tbb::blocked_range<size_t>(0, (*source)->size()),
-		computePixels, tbb::auto_partitioner(), stopper);
+	multi_img_base &src = source->getBase();
+	multi_img *srcimg = dynamic_cast<multi_img*>(&src);
 
-	cv::PCA pca(pixels, cv::noArray(), CV_PCA_DATA_AS_COL, (int)components);
+	/* offloaded images would be read into memory completely for estimation,
+	   use a subsample instead */
+	size_t maxSamples = (srcimg ? 0 : 1 << 18);
 
-	multi_img *target = new multi_img(
-		(*source)->height, (*source)->width, pca.eigenvectors.rows);
-	PcaProjection computeProjection(pixels, *target, pca);
-	tbb::parallel_for(tbb::blocked_range<size_t>(0, target->pixels.size()),
-		computeProjection, tbb::auto_partitioner(), stopper);
+	BandPCA pca;
+	if (!pca.compute(src, components, maxSamples, stopper))
+		return false;
 
-	ApplyCache applyCache(*target);
-	tbb::parallel_for(tbb::blocked_range<size_t>(0, target->size()),
-		applyCache, tbb::auto_partitioner(), stopper);
+	multi_img *target = new multi_img();
+	if (!pca.project(src, *target, stopper)) {
+		delete target;
+		return false;
+	}
 
-	DetermineRange determineRange(*target);
-	tbb::parallel_reduce(tbb::blocked_range<size_t>(0, target->size()),
-		determineRange, tbb::auto_partitioner(), stopper);
+	target->roi = (srcimg ? srcimg->roi
+						  : cv::Rect(0, 0, src.width, src.height));
 
-	if (!stopper.is_group_execution_cancelled()) {
+	if (includecache) {
+		RebuildPixels rebuildPixels(*target);
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, target->size()),
+			rebuildPixels, tbb::auto_partitioner(), stopper);
 		target->dirty.setTo(0);
 		target->anydirt = false;
-		target->minval = determineRange.GetMin();
-		target->maxval = determineRange.GetMax();
-		target->roi = (*source)->roi;
 	}
 
-	if (!includecache)
-		target->resetPixels();
-
 	if (stopper.is_group_execution_cancelled()) {
 		delete target;
 		return false;
@@ -13,56 +13,35 @@
 
 bool RescaleTbb::run()
 {
-	multi_img *temp = new multi_img(**source,
-		cv::Rect(0, 0, (*source)->width, (*source)->height));
-	temp->roi = (*source)->roi;
-	RebuildPixels rebuildPixels(*temp);
-	tbb::parallel_for(tbb::blocked_range<size_t>(0, temp->size()),
-		rebuildPixels, tbb::auto_partitioner(), stopper);
-	temp->dirty.setTo(0);
-	temp->anydirt = false;
+	multi_img &src = **source;
 
 	multi_img *target = NULL;
-	if (newsize != temp->size()) {
-
-		target = new multi_img((*source)->height, (*source)->width, newsize);
-		target->minval = temp->minval;
-		target->maxval = temp->maxval;
-		target->roi = temp->roi;
-		Resize computeResize(*temp, *target, newsize);
-		tbb::parallel_for(tbb::blocked_range2d<int>(0, temp->height,
-		                                            0, temp->width),
-			computeResize, tbb::auto_partitioner(), stopper);
+	if (newsize != src.size()) {
+		target = new multi_img(src.height, src.width, newsize);
+		target->minval = src.minval;
+		target->maxval = src.maxval;
+		target->roi = src.roi;
+
+		// resample band planes, no pixel cache involved
+		cv::Mat1f weights = multi_img::spec_rescale_weights(src.size(), newsize);
+		BandResample computeResample(src, *target, weights);
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, newsize),
+			computeResample, tbb::auto_partitioner(), stopper);
+
+		target->meta = multi_img::spec_rescale_meta(src.meta, newsize);
+	} else {
+		target = new multi_img(src, cv::Rect(0, 0, src.width, src.height));
+		target->roi = src.roi;
+	}
 
-		ApplyCache applyCache(*target);
+	if (includecache) {
+		RebuildPixels rebuildPixels(*target);
 		tbb::parallel_for(tbb::blocked_range<size_t>(0, target->size()),
-			applyCache, tbb::auto_partitioner(), stopper);
+			rebuildPixels, tbb::auto_partitioner(), stopper);
 		target->dirty.setTo(0);
 		target->anydirt = false;
-
-		if (!stopper.is_group_execution_cancelled()) {
-			cv::Mat_<float> tmpmeta1(cv::Size(temp->meta.size(), 1)), tmpmeta2;
-			std::vector<multi_img::BandDesc>::const_iterator it;
-			unsigned int i;
-			for (it = temp->meta.begin(), i = 0; it != temp->meta.end(); it++, i++) {
-				tmpmeta1(0, i) = it->center;
-			}
-			cv::resize(tmpmeta1, tmpmeta2, cv::Size(newsize, 1));
-			for (size_t b = 0; b < newsize; b++) {
-				target->meta[b] = multi_img::BandDesc(tmpmeta2(0, b));
-			}
-		}
-
-		delete temp;
-		temp = NULL;
-
-	} else {
-		target = temp;
 	}
 
-	if (!includecache) // TODO: this absolutely makes no sense? remove param.?
-		target->resetPixels();
-
 	if (stopper.is_group_execution_cancelled()) {
 		delete target;
 		return false;
@@ -72,5 +51,3 @@ bool RescaleTbb::run()
 		return true;
 	}
 }
-
-
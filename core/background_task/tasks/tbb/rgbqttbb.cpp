@@ -5,6 +5,7 @@
 #include <tbb/parallel_for.h>
 
 #include <stopwatch.h>
+#include <trace.h>
 
 
 #include "rgbqttbb.h"
@@ -15,6 +16,7 @@ public:
 		: bgr(bgr), rgb(rgb) {}
 	void operator()(const tbb::blocked_range2d<int> &r) const
 	{
+		TRACE_SPAN("Rgb", "tbb");
 		for (int y = r.rows().begin(); y != r.rows().end(); ++y) {
 			cv::Vec3f *row = bgr[y];
 			QRgb *destrow = (QRgb*)rgb.scanLine(y);
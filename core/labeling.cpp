@@ -15,7 +15,10 @@
 #include <string>
 #include <vector>
 #include <algorithm>
-#include <map>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 
 Labeling::Labeling(const cv::Mat &labeling, bool binary)
 	: yellowcursor(true), shuffle(false), shuffleV(false)
@@ -69,58 +72,128 @@ void Labeling::read(const cv::Mat &src, bool binary)
 
 	/** one-channel case **/
 
-	// determine highest possible intensity
-	int bins = 256;
-	if (src.depth() != CV_8U) {
-		double tmp1, tmp2;
-		cv::minMaxLoc(src, &tmp1, &tmp2);
-		bins = tmp2 + 1;
+	// 8 bit label images are read directly, without conversion
+	if (src.depth() == CV_8U) {
+		readIndexed(cv::Mat1b(src), 256);
+		return;
 	}
+
+	// determine highest possible intensity
+	double tmp1, tmp2;
+	cv::minMaxLoc(src, &tmp1, &tmp2);
+	int bins = tmp2 + 1;
 	// convert to a strict format for convenience -- we don't expect >16 bit
 	cv::Mat1w src1w = src;
 	read(src1w, bins);
 }
 
-struct Vec3bCompare {
-	bool operator() (const cv::Vec3b &a, const cv::Vec3b &b) const
+/* colors packed into 24 bit keys, ordered like the channels (B, G, R) */
+static inline unsigned int packColor(const cv::Vec3b &c)
+{
+	return (c[0] << 16) | (c[1] << 8) | c[2];
+}
+
+static inline cv::Vec3b unpackColor(unsigned int key)
+{
+	return cv::Vec3b(key >> 16, (key >> 8) & 0xff, key & 0xff);
+}
+
+/* collects the distinct packed colors of an image */
+class CollectColors {
+public:
+	CollectColors(const cv::Mat3b &src) : src(src) {}
+	CollectColors(CollectColors &toSplit, tbb::split) : src(toSplit.src) {}
+
+	void operator()(const tbb::blocked_range<int> &r)
 	{
-		if (a[0] == b[0]) {
-			if (a[1] == b[1]) {
-				return (a[2] < b[2]);
+		for (int y = r.begin(); y != r.end(); ++y) {
+			const cv::Vec3b *row = src[y];
+			for (int x = 0; x < src.cols; ++x) {
+				// labelings consist of runs, only store color changes
+				unsigned int key = packColor(row[x]);
+				if (keys.empty() || keys.back() != key)
+					keys.push_back(key);
 			}
-			return a[1] < b[1];
+			if (keys.size() > compactSize)
+				compact();
 		}
-		return a[0] < b[0];
+		compact();
 	}
+
+	void join(CollectColors &toJoin)
+	{
+		keys.insert(keys.end(), toJoin.keys.begin(), toJoin.keys.end());
+		compact();
+	}
+
+	/* sorted distinct keys */
+	std::vector<unsigned int> keys;
+
+private:
+	void compact()
+	{
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		compactSize = std::max<size_t>(2 * keys.size(), 4096);
+	}
+
+	const cv::Mat3b &src;
+	size_t compactSize = 4096;
+};
+
+/* writes the palette index of each pixel color into the label matrix */
+class MapColors {
+public:
+	MapColors(const cv::Mat3b &src, const std::vector<unsigned int> &palette,
+			  cv::Mat1s &labels)
+		: src(src), palette(palette), labels(labels) {}
+
+	void operator()(const tbb::blocked_range<int> &r) const
+	{
+		for (int y = r.begin(); y != r.end(); ++y) {
+			const cv::Vec3b *row = src[y];
+			short *lrow = labels[y];
+			unsigned int last = 0;
+			short index = 0; // palette[0] is black
+			for (int x = 0; x < src.cols; ++x) {
+				unsigned int key = packColor(row[x]);
+				if (key != last) {
+					index = std::lower_bound(palette.begin(), palette.end(),
+											 key) - palette.begin();
+					last = key;
+				}
+				lrow[x] = index;
+			}
+		}
+	}
+
+private:
+	const cv::Mat3b &src;
+	const std::vector<unsigned int> &palette;
+	cv::Mat1s &labels;
 };
 
 void Labeling::read(const cv::Mat3b &src)
 {
-	std::map<cv::Vec3b, short, Vec3bCompare> palette;
-	palette[cv::Vec3b(0, 0, 0)] = -1; // always have black background label
-
 	// find all colors
-	cv::Mat3b::const_iterator its;
-	for (its = src.begin(); its != src.end(); ++its)
-		palette[*its] = -1;
+	CollectColors collect(src);
+	tbb::parallel_reduce(tbb::blocked_range<int>(0, src.rows), collect);
+	std::vector<unsigned int> &palette = collect.keys;
+
+	// always have black background label
+	if (palette.empty() || palette.front() != 0)
+		palette.insert(palette.begin(), 0);
 
-	// assign labelColors based on map order (somewhat canonical label indices)
+	// assign labelColors based on color order (somewhat canonical indices)
 	labelColors.clear();
-	std::map<cv::Vec3b, short, Vec3bCompare>::iterator itp;
-	for (itp = palette.begin(); itp != palette.end(); ++itp)
-	{
-		itp->second = labelColors.size(); // index into labelColors
-		labelColors.push_back(itp->first);
-	}
+	for (size_t i = 0; i < palette.size(); ++i)
+		labelColors.push_back(unpackColor(palette[i]));
 	labelcount = labelColors.size();
 
 	// assign the color indices to the label matrix
 	labels = cv::Mat1s(src.rows, src.cols);
-	cv::Mat1s::iterator itl;
-	for (its = src.begin(), itl = labels.begin();
-		 its != src.end(); ++its, ++itl) {
-		*itl = palette[*its];
-	}
+	tbb::parallel_for(tbb::blocked_range<int>(0, src.rows),
+					  MapColors(src, palette, labels));
 
 	/* Special case: only one white label stored in RGB image (stupid).
 	   We don't want to use white color, it confuses the user. */
@@ -130,19 +203,78 @@ void Labeling::read(const cv::Mat3b &src)
 }
 
 void Labeling::read(const cv::Mat1w &src, int bins)
+{
+	readIndexed(src, bins);
+}
+
+/* marks the intensities used in a one-channel labeling */
+template<typename T>
+class CollectIntensities {
+public:
+	CollectIntensities(const cv::Mat_<T> &src, int bins)
+		: src(src), used(bins, 0) {}
+	CollectIntensities(CollectIntensities &toSplit, tbb::split)
+		: src(toSplit.src), used(toSplit.used.size(), 0) {}
+
+	void operator()(const tbb::blocked_range<int> &r)
+	{
+		for (int y = r.begin(); y != r.end(); ++y) {
+			const T *row = src[y];
+			for (int x = 0; x < src.cols; ++x)
+				used[row[x]] = 1;
+		}
+	}
+
+	void join(CollectIntensities &toJoin)
+	{
+		for (size_t i = 0; i < used.size(); ++i)
+			used[i] |= toJoin.used[i];
+	}
+
+	std::vector<unsigned char> used;
+
+private:
+	const cv::Mat_<T> &src;
+};
+
+/* writes the index of each intensity into the label matrix */
+template<typename T>
+class MapIntensities {
+public:
+	MapIntensities(const cv::Mat_<T> &src, const std::vector<short> &indices,
+				   cv::Mat1s &labels)
+		: src(src), indices(indices), labels(labels) {}
+
+	void operator()(const tbb::blocked_range<int> &r) const
+	{
+		for (int y = r.begin(); y != r.end(); ++y) {
+			const T *row = src[y];
+			short *lrow = labels[y];
+			for (int x = 0; x < src.cols; ++x)
+				lrow[x] = indices[row[x]];
+		}
+	}
+
+private:
+	const cv::Mat_<T> &src;
+	const std::vector<short> &indices;
+	cv::Mat1s &labels;
+};
+
+template<typename T>
+void Labeling::readIndexed(const cv::Mat_<T> &src, int bins)
 {
 	/* find all used intensities */
-	std::vector<int> indices(bins, 0);
+	CollectIntensities<T> collect(src, bins);
+	tbb::parallel_reduce(tbb::blocked_range<int>(0, src.rows), collect);
 	// always have a background label
-	indices[0] = -1;
-	cv::Mat1w::const_iterator its;
-	for (its = src.begin(); its != src.end(); ++its)
-		indices[*its] = -1;
+	collect.used[0] = 1;
 
 	/* assign indices */
+	std::vector<short> indices(bins, 0);
 	labelcount = 0;
 	for (int i = 0; i < bins; ++i) {
-		if (indices[i] == -1)
+		if (collect.used[i])
 			indices[i] = labelcount++;
 	}
 
@@ -152,11 +284,8 @@ void Labeling::read(const cv::Mat1w &src, int bins)
 
 	/* assign the intensity indices to the label matrix */
 	labels = cv::Mat1s(src.rows, src.cols);
-	cv::Mat1s::iterator itl;
-	for (its = src.begin(), itl = labels.begin();
-		 its != src.end(); ++its, ++itl) {
-		*itl = indices[*its];
-	}
+	tbb::parallel_for(tbb::blocked_range<int>(0, src.rows),
+					  MapIntensities<T>(src, indices, labels));
 }
 
 void Labeling::readBinary(const cv::Mat &src)
@@ -207,13 +336,16 @@ cv::Mat3b Labeling::bgr() const
 		buildColors();
 
 	cv::Mat3b ret(labels.rows, labels.cols);
-	for (int y = 0; y < labels.rows; ++y) {
-		cv::Vec3b *rety = ret[y];
-		const short *lbly = labels[y];
-		for (int x = 0; x < labels.cols; ++x) {
-			rety[x] = labelColors[lbly[x]];
+	tbb::parallel_for(tbb::blocked_range<int>(0, labels.rows),
+					  [&](const tbb::blocked_range<int> &r) {
+		for (int y = r.begin(); y != r.end(); ++y) {
+			cv::Vec3b *rety = ret[y];
+			const short *lbly = labels[y];
+			for (int x = 0; x < labels.cols; ++x) {
+				rety[x] = labelColors[lbly[x]];
+			}
 		}
-	}
+	});
 	return ret;
 }
 
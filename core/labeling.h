@@ -139,6 +139,10 @@ protected:
 	/// helper function to build labelColors based on labelcount
 	void buildColors() const;
 
+	/// helper function to read one-channel labeling with given value range
+	template<typename T>
+	void readIndexed(const cv::Mat_<T> &src, int bins);
+
 	mutable std::vector<cv::Vec3b> labelColors;
 	cv::Mat1s labels;
 	int labelcount;
@@ -0,0 +1,255 @@
+#include "bandpca.h"
+#include "multi_img_tbb.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+
+#include <cstring>
+#include <cmath>
+
+/* pixels per tile, keeps the tile of all bands in cache */
+static const int TILE_PIXELS = 1024;
+
+static inline int tileRows(int width)
+{
+	return std::max(1, TILE_PIXELS / width);
+}
+
+/* accumulates band sums and cross products of all pixels */
+class AccumulateCovariance {
+public:
+	AccumulateCovariance(const std::vector<multi_img::Band> &planes)
+		: planes(planes), sums(planes.size(), 1, 0.),
+		  products(planes.size(), planes.size(), 0.) {}
+	AccumulateCovariance(AccumulateCovariance &toSplit, tbb::split)
+		: planes(toSplit.planes), sums(planes.size(), 1, 0.),
+		  products(planes.size(), planes.size(), 0.) {}
+	void operator()(const tbb::blocked_range<int> &r);
+	void join(AccumulateCovariance &toJoin)
+	{
+		sums += toJoin.sums;
+		products += toJoin.products;
+	}
+
+	const std::vector<multi_img::Band> &planes;
+	cv::Mat1d sums;
+	cv::Mat1d products;
+};
+
+void AccumulateCovariance::operator()(const tbb::blocked_range<int> &r)
+{
+	const int width = planes[0].cols;
+	const int tilerows = tileRows(width);
+
+	// accumulate in double precision to avoid cancellation
+	cv::Mat1d tile, tilesums, tileproducts;
+	for (int y = r.begin(); y < r.end(); y += tilerows) {
+		int rows = std::min(tilerows, r.end() - y);
+		tile.create(planes.size(), rows * width);
+		for (size_t b = 0; b < planes.size(); ++b) {
+			double *dst = tile[b];
+			for (int row = y; row < y + rows; ++row) {
+				const float *src = planes[b][row];
+				for (int x = 0; x < width; ++x)
+					*dst++ = src[x];
+			}
+		}
+		cv::reduce(tile, tilesums, 1, CV_REDUCE_SUM);
+		cv::mulTransposed(tile, tileproducts, false);
+		sums += tilesums;
+		products += tileproducts;
+	}
+}
+
+/* projects tiles of band planes into target bands */
+class ProjectTiles {
+public:
+	ProjectTiles(const std::vector<multi_img::Band> &planes,
+				 const cv::Mat1f &eigenvectors, const cv::Mat1f &offset,
+				 std::vector<multi_img::Band> &target)
+		: planes(planes), eigenvectors(eigenvectors), offset(offset),
+		  target(target) {}
+
+	void operator()(const tbb::blocked_range<int> &r) const
+	{
+		const int width = planes[0].cols;
+		const int tilerows = tileRows(width);
+
+		cv::Mat1f tile, result;
+		for (int y = r.begin(); y < r.end(); y += tilerows) {
+			int rows = std::min(tilerows, r.end() - y);
+			tile.create(planes.size(), rows * width);
+			for (size_t b = 0; b < planes.size(); ++b) {
+				float *dst = tile[b];
+				for (int row = y; row < y + rows; ++row, dst += width)
+					std::memcpy(dst, planes[b][row], width * sizeof(float));
+			}
+			cv::gemm(eigenvectors, tile, 1., cv::noArray(), 0., result);
+			for (size_t c = 0; c < target.size(); ++c) {
+				const float *src = result[c];
+				const float o = offset(c);
+				for (int row = y; row < y + rows; ++row) {
+					float *dst = target[c][row];
+					for (int x = 0; x < width; ++x)
+						dst[x] = *src++ - o;
+				}
+			}
+		}
+	}
+
+private:
+	const std::vector<multi_img::Band> &planes;
+	const cv::Mat1f &eigenvectors;
+	const cv::Mat1f &offset;
+	std::vector<multi_img::Band> &target;
+};
+
+BandPCA::BandPCA(const cv::PCA &pca)
+{
+	// we store the mean as column vector
+	if (pca.mean.rows == 1)
+		cv::Mat(pca.mean.t()).convertTo(mean, CV_32F);
+	else
+		pca.mean.convertTo(mean, CV_32F);
+	pca.eigenvectors.convertTo(eigenvectors, CV_32F);
+	pca.eigenvalues.convertTo(eigenvalues, CV_32F);
+}
+
+void BandPCA::compute(const multi_img_base &image, unsigned int components,
+					  size_t maxSamples)
+{
+	tbb::task_group_context ctx;
+	compute(image, components, maxSamples, ctx);
+}
+
+bool BandPCA::compute(const multi_img_base &image, unsigned int components,
+					  size_t maxSamples, tbb::task_group_context &ctx)
+{
+	const size_t nbands = image.size();
+	if (components == 0 || components > nbands)
+		components = nbands;
+	if (image.empty() || image.width == 0 || image.height == 0) {
+		mean.release(); eigenvectors.release(); eigenvalues.release();
+		return true;
+	}
+
+	// regular sampling grid
+	size_t npixels = (size_t)image.width * image.height;
+	int step = 1;
+	if (maxSamples > 0 && npixels > maxSamples)
+		step = (int)std::ceil(std::sqrt((double)npixels / maxSamples));
+
+	/* band headers, or subsampled copies. Note that an offloaded image will
+	   be held in memory completely if no subsampling is done. */
+	std::vector<multi_img::Band> planes(nbands);
+	for (size_t b = 0; b < nbands; ++b) {
+		multi_img::Band band;
+		image.getBand(b, band);
+		if (step == 1) {
+			planes[b] = band;
+		} else {
+			multi_img::Band &s = planes[b];
+			s.create((band.rows + step - 1) / step,
+					 (band.cols + step - 1) / step);
+			for (int y = 0; y < s.rows; ++y) {
+				const float *src = band[y * step];
+				float *dst = s[y];
+				for (int x = 0; x < s.cols; ++x)
+					dst[x] = src[x * step];
+			}
+		}
+
+		if (ctx.is_group_execution_cancelled())
+			return false;
+	}
+
+	AccumulateCovariance accumulate(planes);
+	tbb::parallel_reduce(tbb::blocked_range<int>(0, planes[0].rows,
+												 tileRows(planes[0].cols)),
+		accumulate, tbb::auto_partitioner(), ctx);
+	if (ctx.is_group_execution_cancelled())
+		return false;
+
+	double n = (double)planes[0].rows * planes[0].cols;
+	cv::Mat1d mu = accumulate.sums / n;
+	cv::Mat1d covar = accumulate.products / n - mu * mu.t();
+
+	// eigenvalues in descending order, eigenvectors as rows
+	cv::Mat1d evals, evecs;
+	cv::eigen(covar, evals, evecs);
+
+	mu.convertTo(mean, CV_32F);
+	evecs.rowRange(0, components).convertTo(eigenvectors, CV_32F);
+	evals.rowRange(0, components).convertTo(eigenvalues, CV_32F);
+	return true;
+}
+
+multi_img BandPCA::project(const multi_img_base &image) const
+{
+	multi_img ret;
+	tbb::task_group_context ctx;
+	project(image, ret, ctx);
+	return ret;
+}
+
+bool BandPCA::project(const multi_img_base &image, multi_img &target,
+					  tbb::task_group_context &ctx) const
+{
+	assert((int)image.size() == eigenvectors.cols);
+	const size_t ncomp = eigenvectors.rows;
+
+	target.init(image.height, image.width, ncomp);
+	if (ncomp == 0 || image.width == 0 || image.height == 0)
+		return true;
+
+	// projection of the mean
+	cv::Mat1f offset = eigenvectors * mean;
+
+	if (dynamic_cast<const multi_img*>(&image)) {
+		/* all bands in memory: tiled matrix multiplication */
+		std::vector<multi_img::Band> planes(image.size());
+		for (size_t b = 0; b < planes.size(); ++b)
+			image.getBand(b, planes[b]);
+
+		tbb::parallel_for(tbb::blocked_range<int>(0, image.height,
+												  tileRows(image.width)),
+			ProjectTiles(planes, eigenvectors, offset, target.bands),
+			tbb::auto_partitioner(), ctx);
+	} else {
+		/* bands are fetched one by one: accumulate into components */
+		for (size_t c = 0; c < ncomp; ++c)
+			target.bands[c].setTo(-offset(c));
+
+		for (size_t b = 0; b < image.size(); ++b) {
+			multi_img::Band band;
+			image.getBand(b, band);
+			for (size_t c = 0; c < ncomp; ++c)
+				cv::scaleAdd(band, eigenvectors(c, b),
+							 target.bands[c], target.bands[c]);
+
+			if (ctx.is_group_execution_cancelled())
+				return false;
+		}
+	}
+	if (ctx.is_group_execution_cancelled())
+		return false;
+
+	// set min/max as observed
+	DetermineRange determineRange(target);
+	tbb::parallel_reduce(tbb::blocked_range<size_t>(0, target.size()),
+		determineRange, tbb::auto_partitioner(), ctx);
+	target.minval = determineRange.GetMin();
+	target.maxval = determineRange.GetMax();
+
+	return !ctx.is_group_execution_cancelled();
+}
+
+cv::PCA BandPCA::pca() const
+{
+	cv::PCA ret;
+	ret.mean = mean.clone();
+	ret.eigenvectors = eigenvectors.clone();
+	ret.eigenvalues = eigenvalues.clone();
+	return ret;
+}
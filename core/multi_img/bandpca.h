@@ -0,0 +1,59 @@
+#ifndef BANDPCA_H
+#define BANDPCA_H
+
+#include <multi_img.h>
+#include <tbb/task.h>
+
+/** Principal component analysis on band planes.
+
+	The band covariance is accumulated in one parallel pass over tiles of
+	the band planes, without creating an interleaved copy of the image.
+	Only the requested number of components is kept. Optionally, the
+	covariance is estimated from a regular subsample of the pixels.
+
+	Projection writes directly into the bands of the target image. Images
+	that do not keep their bands in memory (multi_img_offloaded) are read
+	band by band, both for estimation and projection.
+*/
+class BandPCA {
+public:
+	BandPCA() {}
+
+	/// take over an existing OpenCV PCA (data as columns)
+	explicit BandPCA(const cv::PCA &pca);
+
+	/// compute PCA of the image
+	/**
+	  @param components number of components to keep (if 0, keep #bands)
+	  @param maxSamples estimate on a regular grid of at most maxSamples
+	                    pixels (if 0, use all pixels)
+	  */
+	void compute(const multi_img_base &image, unsigned int components = 0,
+				 size_t maxSamples = 0);
+
+	/// compute PCA of the image, cancelable
+	/** @return false if computation was cancelled through ctx */
+	bool compute(const multi_img_base &image, unsigned int components,
+				 size_t maxSamples, tbb::task_group_context &ctx);
+
+	/// project image into components, one band per component
+	/** minval and maxval of the result are set to the observed range. */
+	multi_img project(const multi_img_base &image) const;
+
+	/// project image into components, cancelable
+	/** @return false if computation was cancelled through ctx */
+	bool project(const multi_img_base &image, multi_img &target,
+				 tbb::task_group_context &ctx) const;
+
+	/// convert for use with cv::PCA based functions
+	cv::PCA pca() const;
+
+	/// mean vector (#bands x 1)
+	cv::Mat1f mean;
+	/// principal components (#components x #bands), one per row
+	cv::Mat1f eigenvectors;
+	/// variance of each component (#components x 1)
+	cv::Mat1f eigenvalues;
+};
+
+#endif // BANDPCA_H
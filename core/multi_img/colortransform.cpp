@@ -0,0 +1,277 @@
+#include "colortransform.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <cstring>
+#include <cmath>
+
+/* sRGB gamma curve, sampled for linear interpolation on [0, 1] */
+struct GammaTable {
+	enum { SIZE = 4096 };
+
+	GammaTable() {
+		const float gamma = 1.f/2.4f;
+		for (int i = 0; i < SIZE; ++i) {
+			float v = i / (float)(SIZE - 1);
+			if (v > 0.0031308f)
+				values[i] = 1.055f * std::pow(v, gamma) - 0.055f;
+			else
+				values[i] = 12.92f * v;
+		}
+		// guard entry for interpolation at v == 1
+		values[SIZE] = values[SIZE - 1];
+	}
+
+	/* pos is clamped to [0, SIZE - 1], NaN maps to 0 as in the SSE path */
+	inline float at(float pos) const {
+		pos = (!(pos > 0.f) ? 0.f : std::min(pos, (float)(SIZE - 1)));
+		int idx = (int)pos;
+		float frac = pos - idx;
+		return values[idx] + frac * (values[idx + 1] - values[idx]);
+	}
+
+	float values[SIZE + 1];
+};
+
+static const GammaTable& gammaTable()
+{
+	static const GammaTable table;
+	return table;
+}
+
+ColorTransform::ColorTransform(const std::vector<multi_img::BandDesc> &meta,
+							   multi_img::Value maxval)
+	: meta(meta), maxval(maxval),
+	  xyzWeights(multi_img::xyz_weights(meta, maxval))
+{
+	for (int i = 0; i < xyzWeights.rows; ++i) {
+		const float *w = xyzWeights[i];
+		if (w[0] != 0.f || w[1] != 0.f || w[2] != 0.f)
+			used.push_back(i);
+	}
+
+	usedWeightsT = cv::Mat1f(3, used.size());
+	for (size_t i = 0; i < used.size(); ++i) {
+		for (int c = 0; c < 3; ++c)
+			usedWeightsT(c, i) = xyzWeights(used[i], c);
+	}
+}
+
+bool ColorTransform::matches(const std::vector<multi_img::BandDesc> &m,
+							 multi_img::Value mv) const
+{
+	if (mv != maxval || m.size() != meta.size())
+		return false;
+	for (size_t i = 0; i < meta.size(); ++i) {
+		if (m[i].center != meta[i].center || m[i].empty != meta[i].empty)
+			return false;
+	}
+	return true;
+}
+
+cv::Vec3f ColorTransform::bgr(const multi_img::Pixel &p) const
+{
+	assert(p.size() == (size_t)xyzWeights.rows);
+	float xyz[3] = { 0.f, 0.f, 0.f };
+	for (size_t i = 0; i < used.size(); ++i) {
+		const float *w = xyzWeights[used[i]];
+		float v = p[used[i]];
+		xyz[0] += w[0] * v;
+		xyz[1] += w[1] * v;
+		xyz[2] += w[2] * v;
+	}
+	cv::Vec3f ret;
+	xyz2bgr(&xyz[0], &xyz[1], &xyz[2], &ret, 1);
+	return ret;
+}
+
+void ColorTransform::bgr(const cv::Mat1f &spectra, cv::Mat3f &result) const
+{
+	assert(spectra.cols == xyzWeights.rows);
+	result.create(spectra.rows, 1);
+	if (spectra.empty())
+		return;
+
+	// transposed product gives planar XYZ data (3 x #spectra)
+	cv::Mat1f xyz;
+	cv::gemm(xyzWeights, spectra, 1., cv::noArray(), 0., xyz,
+			 cv::GEMM_1_T | cv::GEMM_2_T);
+	xyz2bgr(xyz[0], xyz[1], xyz[2], result[0], spectra.rows);
+}
+
+/* converts image rows tile-wise, band planes of a tile times weights */
+class ColorTiles {
+public:
+	ColorTiles(const std::vector<multi_img::Band> &bands,
+			   const cv::Mat1f &weightsT, cv::Mat3f &result)
+		: bands(bands), weightsT(weightsT), result(result) {}
+
+	void operator()(const tbb::blocked_range<int> &r) const
+	{
+		const int width = result.cols;
+		// keep tiles small enough to stay in cache
+		const int tilerows = std::max(1, TILE_PIXELS / width);
+
+		cv::Mat1f planes, xyz;
+		for (int y = r.begin(); y < r.end(); y += tilerows) {
+			int rows = std::min(tilerows, r.end() - y);
+			int npix = rows * width;
+			planes.create(bands.size(), npix);
+			for (size_t b = 0; b < bands.size(); ++b) {
+				float *dst = planes[b];
+				for (int row = y; row < y + rows; ++row, dst += width)
+					std::memcpy(dst, bands[b][row], width * sizeof(float));
+			}
+			cv::gemm(weightsT, planes, 1., cv::noArray(), 0., xyz);
+			ColorTransform::xyz2bgr(xyz[0], xyz[1], xyz[2], result[y], npix);
+		}
+	}
+
+	static const int TILE_PIXELS = 4096;
+
+private:
+	const std::vector<multi_img::Band> &bands;
+	const cv::Mat1f &weightsT;
+	cv::Mat3f &result;
+};
+
+/* converts rows of planar XYZ data */
+class ColorRows {
+public:
+	ColorRows(const std::vector<cv::Mat1f> &xyz, cv::Mat3f &result)
+		: xyz(xyz), result(result) {}
+
+	void operator()(const tbb::blocked_range<int> &r) const
+	{
+		for (int y = r.begin(); y != r.end(); ++y) {
+			ColorTransform::xyz2bgr(xyz[0][y], xyz[1][y], xyz[2][y],
+									result[y], result.cols);
+		}
+	}
+
+private:
+	const std::vector<cv::Mat1f> &xyz;
+	cv::Mat3f &result;
+};
+
+cv::Mat3f ColorTransform::bgr(const multi_img_base &image) const
+{
+	tbb::task_group_context ctx;
+	cv::Mat3f ret;
+	bgr(image, ret, ctx);
+	return ret;
+}
+
+bool ColorTransform::bgr(const multi_img_base &image, cv::Mat3f &result,
+						 tbb::task_group_context &ctx) const
+{
+	assert(image.size() == (size_t)xyzWeights.rows);
+	result.create(image.height, image.width);
+	if (result.empty())
+		return true;
+
+	if (dynamic_cast<const multi_img*>(&image)) {
+		/* all bands in memory: tiled matrix multiplication */
+		std::vector<multi_img::Band> bands(used.size());
+		for (size_t i = 0; i < used.size(); ++i)
+			image.getBand(used[i], bands[i]);
+
+		if (bands.empty()) {
+			result.setTo(0.f);
+			return true;
+		}
+
+		int grain = std::max(1, ColorTiles::TILE_PIXELS / image.width);
+		tbb::parallel_for(tbb::blocked_range<int>(0, image.height, grain),
+						  ColorTiles(bands, usedWeightsT, result),
+						  tbb::auto_partitioner(), ctx);
+	} else {
+		/* bands are fetched one by one: accumulate XYZ planes */
+		std::vector<cv::Mat1f> xyz(3);
+		for (int c = 0; c < 3; ++c)
+			xyz[c] = cv::Mat1f(image.height, image.width, 0.f);
+
+		for (size_t i = 0; i < used.size(); ++i) {
+			multi_img::Band band;
+			image.getBand(used[i], band);
+			for (int c = 0; c < 3; ++c)
+				cv::scaleAdd(band, usedWeightsT(c, i), xyz[c], xyz[c]);
+
+			if (ctx.is_group_execution_cancelled())
+				return false;
+		}
+
+		tbb::parallel_for(tbb::blocked_range<int>(0, image.height),
+						  ColorRows(xyz, result), tbb::auto_partitioner(), ctx);
+	}
+
+	return !ctx.is_group_execution_cancelled();
+}
+
+void ColorTransform::xyz2bgr(const float *x, const float *y, const float *z,
+							 cv::Vec3f *bgr, size_t n)
+{
+	const GammaTable &gamma = gammaTable();
+	const float scale = (float)(GammaTable::SIZE - 1);
+
+	/* Inverse M for sRGB, D65, see multi_img::xyz2bgr() */
+	const __m128 mr[3] = { _mm_set1_ps( 3.2404542f),
+						   _mm_set1_ps(-1.5371385f),
+						   _mm_set1_ps(-0.4985314f) };
+	const __m128 mg[3] = { _mm_set1_ps(-0.9692660f),
+						   _mm_set1_ps( 1.8760108f),
+						   _mm_set1_ps( 0.0415560f) };
+	const __m128 mb[3] = { _mm_set1_ps( 0.0556434f),
+						   _mm_set1_ps(-0.2040259f),
+						   _mm_set1_ps( 1.0572252f) };
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 maxpos = _mm_set1_ps(scale);
+
+	size_t i = 0;
+	float pos[3][4];
+	for (; i + 4 <= n; i += 4) {
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+		__m128 vz = _mm_loadu_ps(z + i);
+
+		__m128 vb = _mm_add_ps(_mm_mul_ps(mb[0], vx), _mm_add_ps(
+					_mm_mul_ps(mb[1], vy), _mm_mul_ps(mb[2], vz)));
+		__m128 vg = _mm_add_ps(_mm_mul_ps(mg[0], vx), _mm_add_ps(
+					_mm_mul_ps(mg[1], vy), _mm_mul_ps(mg[2], vz)));
+		__m128 vr = _mm_add_ps(_mm_mul_ps(mr[0], vx), _mm_add_ps(
+					_mm_mul_ps(mr[1], vy), _mm_mul_ps(mr[2], vz)));
+
+		// sanitize and map to gamma table position
+		vb = _mm_min_ps(_mm_max_ps(_mm_mul_ps(vb, maxpos), zero), maxpos);
+		vg = _mm_min_ps(_mm_max_ps(_mm_mul_ps(vg, maxpos), zero), maxpos);
+		vr = _mm_min_ps(_mm_max_ps(_mm_mul_ps(vr, maxpos), zero), maxpos);
+		_mm_storeu_ps(pos[0], vb);
+		_mm_storeu_ps(pos[1], vg);
+		_mm_storeu_ps(pos[2], vr);
+
+		for (int k = 0; k < 4; ++k) {
+			cv::Vec3f &d = bgr[i + k];
+			d[0] = gamma.at(pos[0][k]);
+			d[1] = gamma.at(pos[1][k]);
+			d[2] = gamma.at(pos[2][k]);
+		}
+	}
+
+	// remainder
+	for (; i < n; ++i) {
+		float v[3];
+		v[0] =  0.0556434f * x[i] + -0.2040259f * y[i] +  1.0572252f * z[i];
+		v[1] = -0.9692660f * x[i] +  1.8760108f * y[i] +  0.0415560f * z[i];
+		v[2] =  3.2404542f * x[i] + -1.5371385f * y[i] + -0.4985314f * z[i];
+		cv::Vec3f &d = bgr[i];
+		for (int c = 0; c < 3; ++c) {
+			// NaN maps to 0, as with _mm_max_ps() above
+			float p = v[c] * scale;
+			p = (!(p > 0.f) ? 0.f : std::min(p, scale));
+			d[c] = gamma.at(p);
+		}
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef COLORTRANSFORM_H
+#define COLORTRANSFORM_H
+
+#include <multi_img.h>
+#include <tbb/task.h>
+
+/** Conversion of spectra to sRGB based on the CIE 1931 standard observer.
+
+	The XYZ weights of all bands are computed once for a band layout and
+	kept in a (#bands x 3) matrix. Images are converted tile-wise: the band
+	planes of a tile are multiplied with the weight matrix (SGEMM), followed
+	by a single vectorized pass that performs the XYZ -> sRGB transform
+	including clamping and gamma correction.
+
+	The results equal multi_img::pixel2xyz() followed by
+	multi_img::xyz2bgr() up to rounding.
+*/
+class ColorTransform {
+public:
+	/// empty transform, use matches() to test before use
+	ColorTransform() : maxval(0.f) {}
+
+	/// create transform for given band layout and value range
+	ColorTransform(const std::vector<multi_img::BandDesc> &meta,
+				   multi_img::Value maxval);
+
+	/// returns true if the transform was built for given layout and range
+	bool matches(const std::vector<multi_img::BandDesc> &meta,
+				 multi_img::Value maxval) const;
+
+	/// XYZ weight matrix (#bands x 3)
+	const cv::Mat1f& weights() const { return xyzWeights; }
+
+	/// convert a single spectrum
+	cv::Vec3f bgr(const multi_img::Pixel &p) const;
+
+	/// convert many spectra (one per row) at once, result has one row each
+	void bgr(const cv::Mat1f &spectra, cv::Mat3f &result) const;
+
+	/// convert whole image
+	cv::Mat3f bgr(const multi_img_base &image) const;
+
+	/// convert whole image, cancelable
+	/** @return false if computation was cancelled through ctx */
+	bool bgr(const multi_img_base &image, cv::Mat3f &result,
+			 tbb::task_group_context &ctx) const;
+
+	/// XYZ -> sRGB conversion of n planar XYZ values (vectorized)
+	static void xyz2bgr(const float *x, const float *y, const float *z,
+						cv::Vec3f *bgr, size_t n);
+
+private:
+	std::vector<multi_img::BandDesc> meta;
+	multi_img::Value maxval;
+
+	cv::Mat1f xyzWeights;
+	/// indices of bands that contribute (non-zero weights)
+	std::vector<int> used;
+	/// transposed weights of used bands only (3 x #used)
+	cv::Mat1f usedWeightsT;
+};
+
+#endif // COLORTRANSFORM_H
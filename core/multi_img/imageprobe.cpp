@@ -0,0 +1,215 @@
+#include "imageprobe.h"
+
+#include <opencv2/core/core.hpp>
+#include <fstream>
+#include <cstring>
+#include <cctype>
+
+/* integer from bytes in big or little endian order */
+static unsigned int fromBytes(const unsigned char *b, int n, bool bigEndian)
+{
+	unsigned int ret = 0;
+	for (int i = 0; i < n; ++i)
+		ret |= (unsigned int)b[bigEndian ? i : n - 1 - i] << (8 * (n - 1 - i));
+	return ret;
+}
+
+static bool probePNG(std::ifstream &in, ImageHeader &header)
+{
+	static const unsigned char signature[8] =
+		{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	// signature, IHDR chunk length and type, IHDR data
+	unsigned char buf[8 + 8 + 13];
+	in.read((char*)buf, sizeof(buf));
+	if (!in || std::memcmp(buf, signature, 8) != 0
+		|| std::memcmp(buf + 12, "IHDR", 4) != 0)
+		return false;
+
+	header.width = fromBytes(buf + 16, 4, true);
+	header.height = fromBytes(buf + 20, 4, true);
+	int bitdepth = buf[24];
+	int colortype = buf[25];
+
+	switch (colortype) {
+	case 0: header.channels = 1; break; // grayscale
+	case 2: header.channels = 3; break; // RGB
+	case 6: header.channels = 4; break; // RGBA
+	default: return false; // palette, grayscale + alpha
+	}
+	header.depth = (bitdepth == 16 ? CV_16U : CV_8U);
+
+	/* transparency information adds an alpha channel when decoded. It can
+	   only appear before image data, so skip chunks until then */
+	in.seekg(8 + 8 + 13 + 4, std::ios::beg); // after IHDR and its CRC
+	while (in.read((char*)buf, 8)) {
+		unsigned int length = fromBytes(buf, 4, true);
+		if (std::memcmp(buf + 4, "IDAT", 4) == 0)
+			return true;
+		if (std::memcmp(buf + 4, "tRNS", 4) == 0)
+			return false;
+		in.seekg(length + 4, std::ios::cur); // data and CRC
+	}
+	return false;
+}
+
+static bool probeTIFF(std::ifstream &in, ImageHeader &header)
+{
+	unsigned char buf[12];
+	in.read((char*)buf, 8);
+	if (!in)
+		return false;
+	bool big;
+	if (buf[0] == 'I' && buf[1] == 'I')
+		big = false;
+	else if (buf[0] == 'M' && buf[1] == 'M')
+		big = true;
+	else
+		return false;
+	if (fromBytes(buf + 2, 2, big) != 42)
+		return false; // BigTIFF or not a TIFF at all
+
+	in.seekg(fromBytes(buf + 4, 4, big), std::ios::beg);
+	in.read((char*)buf, 2);
+	if (!in)
+		return false;
+	unsigned int entries = fromBytes(buf, 2, big);
+
+	// defaults as per TIFF 6.0 specification
+	unsigned int width = 0, height = 0, bits = 1, samples = 1,
+			photometric = ~0u, format = 1, planar = 1;
+	for (unsigned int i = 0; i < entries; ++i) {
+		in.read((char*)buf, 12);
+		if (!in)
+			return false;
+		unsigned int tag = fromBytes(buf, 2, big);
+		unsigned int type = fromBytes(buf + 2, 2, big);
+		unsigned int count = fromBytes(buf + 4, 4, big);
+
+		// we only need the first value of SHORT or LONG fields
+		unsigned int value;
+		if (type == 3) { // SHORT
+			if (count > 2) { // stored at offset
+				std::streampos pos = in.tellg();
+				unsigned char v[2];
+				in.seekg(fromBytes(buf + 8, 4, big), std::ios::beg);
+				in.read((char*)v, 2);
+				in.seekg(pos);
+				if (!in)
+					return false;
+				value = fromBytes(v, 2, big);
+			} else {
+				value = fromBytes(buf + 8, 2, big);
+			}
+		} else if (type == 4 && count == 1) { // LONG
+			value = fromBytes(buf + 8, 4, big);
+		} else {
+			continue;
+		}
+
+		switch (tag) {
+		case 256: width = value; break;
+		case 257: height = value; break;
+		case 258: bits = value; break;
+		case 262: photometric = value; break;
+		case 277: samples = value; break;
+		case 284: planar = value; break;
+		case 339: format = value; break;
+		}
+	}
+
+	if (width == 0 || height == 0 || (samples > 1 && planar != 1))
+		return false;
+
+	/* gray or RGB only, others get converted when decoded. OpenCV 2.4 drops
+	   alpha from TIFF, so extra samples are left to the decoder as well. */
+	if ((photometric == 0 || photometric == 1) && samples == 1)
+		header.channels = 1;
+	else if (photometric == 2 && samples == 3)
+		header.channels = 3;
+	else
+		return false;
+
+	if (format == 1 && bits == 8)
+		header.depth = CV_8U;
+	else if (format == 1 && bits == 16)
+		header.depth = CV_16U;
+	else if (format == 3 && bits == 32)
+		header.depth = CV_32F;
+	else if (format == 3 && bits == 64)
+		header.depth = CV_64F;
+	else
+		return false;
+
+	header.width = width;
+	header.height = height;
+	return true;
+}
+
+/* reads next number from PNM header, skipping whitespace and comments */
+static bool pnmNumber(std::ifstream &in, unsigned int &value)
+{
+	int c = in.get();
+	while (in && (std::isspace(c) || c == '#')) {
+		if (c == '#') {
+			while (in && c != '\n')
+				c = in.get();
+		}
+		c = in.get();
+	}
+	if (!in || !std::isdigit(c))
+		return false;
+
+	value = 0;
+	while (in && std::isdigit(c)) {
+		value = value * 10 + (c - '0');
+		c = in.get();
+	}
+	return true;
+}
+
+static bool probePNM(std::ifstream &in, ImageHeader &header)
+{
+	char magic[2];
+	in.read(magic, 2);
+	if (!in || magic[0] != 'P')
+		return false;
+
+	switch (magic[1]) {
+	case '2': case '5': header.channels = 1; break; // PGM
+	case '3': case '6': header.channels = 3; break; // PPM
+	default: return false; // PBM, PAM
+	}
+
+	unsigned int width, height, maxval;
+	if (!pnmNumber(in, width) || !pnmNumber(in, height)
+		|| !pnmNumber(in, maxval))
+		return false;
+
+	header.width = width;
+	header.height = height;
+	header.depth = (maxval > 255 ? CV_16U : CV_8U);
+	return width > 0 && height > 0;
+}
+
+bool probeImageHeader(const std::string &filename, ImageHeader &header)
+{
+	std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+	if (!in)
+		return false;
+
+	// determine format by magic number
+	unsigned char magic[2];
+	in.read((char*)magic, 2);
+	if (!in)
+		return false;
+	in.seekg(0, std::ios::beg);
+
+	if (magic[0] == 0x89 && magic[1] == 'P')
+		return probePNG(in, header);
+	if ((magic[0] == 'I' && magic[1] == 'I')
+		|| (magic[0] == 'M' && magic[1] == 'M'))
+		return probeTIFF(in, header);
+	if (magic[0] == 'P')
+		return probePNM(in, header);
+	return false;
+}
@@ -0,0 +1,23 @@
+#ifndef IMAGEPROBE_H
+#define IMAGEPROBE_H
+
+#include <string>
+
+/// image properties as returned by cv::imread(file, -1)
+struct ImageHeader {
+	ImageHeader() : width(0), height(0), channels(0), depth(0) {}
+
+	int width, height;
+	int channels;
+	/// OpenCV depth (CV_8U, CV_16U, CV_32F)
+	int depth;
+};
+
+/// read image properties from the file header, without decoding pixel data
+/** Supported are PNG, TIFF and PNM (PGM/PPM). Variants where the decoded
+	layout is not evident from the header (e.g. palette images) are rejected.
+	@return false if the file could not be probed; use cv::imread() then
+*/
+bool probeImageHeader(const std::string &filename, ImageHeader &header);
+
+#endif // IMAGEPROBE_H
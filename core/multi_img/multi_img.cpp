@@ -8,6 +8,10 @@
 
 #include "multi_img.h"
 #ifdef WITH_OPENCV2 // theoretically, vole could be built w/o opencv..
+#include "bandpca.h"
+#include "multi_img_tbb.h"
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -68,10 +72,8 @@ multi_img & multi_img::operator=(const multi_img &a) {
 		meta = a.meta;
 		roi = a.roi;
 
-		// image data
-		bands.resize(a.bands.size());
-		for (size_t i = 0; i < bands.size(); ++i)
-			bands[i] = a.bands[i].clone();
+		// image data, shared until written to (see detachBand())
+		bands = a.bands;
 
 		// cache data
 		pixels = a.pixels;
@@ -82,11 +84,10 @@ multi_img & multi_img::operator=(const multi_img &a) {
 }
 
 multi_img::multi_img(const multi_img &a, bool omitCache)
- : multi_img_base(a), roi(a.roi), bands(a.size())
+ : multi_img_base(a), roi(a.roi), bands(a.bands)
 {
+	// band data is shared until written to (see detachBand())
 	std::cerr << "multi_img: copy" << std::endl;
-	for (size_t i = 0; i < bands.size(); ++i)
-		bands[i] = a.bands[i].clone();
 
 	if (omitCache) {
 		resetPixels();
@@ -102,11 +103,8 @@ multi_img::multi_img(const multi_img_base &a, const cv::Rect &roi)
 {
 	width = roi.width;
 	height = roi.height;
-	for (size_t i = 0; i < bands.size(); ++i) {
-		Band band;
-		a.getBand(i, band);
-		a.scopeBand(band, roi, bands[i]);
-	}
+	for (size_t i = 0; i < bands.size(); ++i)
+		a.getScopedBand(i, roi, bands[i]);
 	/* FIXME: - inconsistent to other copy constr.
 	          - will lead to corrupt cache data!
                 use vector of pointers for cache and copy them, too? */
@@ -131,6 +129,27 @@ multi_img::multi_img(const multi_img &a, unsigned int start, unsigned int end) :
 	resetPixels();
 }
 
+bool multi_img::isShared(const Band &band)
+{
+#if CV_MAJOR_VERSION >= 3
+	return band.u && band.u->refcount > 1;
+#else
+	return band.refcount && *band.refcount > 1;
+#endif
+}
+
+void multi_img::detachBand(size_t band, bool preserve)
+{
+	Band &b = bands[band];
+	if (!isShared(b))
+		return;
+
+	if (preserve)
+		b = b.clone();
+	else
+		b = Band(b.rows, b.cols);
+}
+
 void multi_img::resetPixels(bool force) const
 {
 	if (force || pixels.empty()) {
@@ -149,6 +168,9 @@ void multi_img::rebuildPixels(bool optimistic) const
 		return;
 
 	std::cerr << "multi_img: complete rebuild" << std::endl;
+	// pixels may have been released
+	for (size_t i = 0; i < pixels.size(); ++i)
+		pixels[i].resize(size());
 	Band::const_iterator it;
 	register unsigned int d, i;
 	for (d = 0; d < size(); ++d) {
@@ -164,12 +186,22 @@ void multi_img::rebuildPixel(unsigned int row, unsigned int col) const
 {
 	std::cerr << "multi_img: rebuild pixel " << row << "." << col << std::endl;
 	Pixel &p = pixels[row*width + col];
+	p.resize(size()); // pixel may have been released
 	for (size_t i = 0; i < size(); ++i)
 		p[i] = bands[i](row, col);
 
 	dirty(row, col) = 0;
 }
 
+void multi_img::releasePixels() const
+{
+	for (size_t i = 0; i < pixels.size(); ++i)
+		Pixel().swap(pixels[i]);
+	if (!dirty.empty())
+		dirty.setTo(255);
+	anydirt = true;
+}
+
 std::vector<const multi_img::Pixel*> multi_img::getSegment(const cv::Mat1b &mask)
 {
 	assert(mask.rows == height && mask.cols == width);
@@ -213,8 +245,10 @@ void multi_img::setPixel(unsigned int row, unsigned int col,
 	assert(values.size() == size());
 	Pixel &p = pixels[row*width + col];
 	p = values;
-	for (size_t i = 0; i < size(); ++i)
+	for (size_t i = 0; i < size(); ++i) {
+		detachBand(i);
 		bands[i](row, col) = p[i];
+	}
 
 	dirty(row, col) = 0;
 }
@@ -228,8 +262,10 @@ void multi_img::setPixel(unsigned int row, unsigned int col,
 	Pixel &p = pixels[row*width + col];
 	p.assign(values.begin(), values.end());
 
-	for (size_t i = 0; i < size(); ++i)
+	for (size_t i = 0; i < size(); ++i) {
+		detachBand(i);
 		bands[i](row, col) = p[i];
+	}
 
 	dirty(row, col) = 0;
 }
@@ -239,6 +275,8 @@ void multi_img::setBand(unsigned int band, const Band &data,
 {
 	assert(band < size());
 	assert(data.rows == height && data.cols == width);
+	// without mask, all previous content is overwritten
+	detachBand(band, !mask.empty());
 	Band &b = bands[band];
 	Band::const_iterator bit = b.begin();
 	cv::Mat1b::const_iterator dit = dirty.begin();
@@ -296,13 +334,16 @@ void multi_img::setSegment(const std::vector<cv::Mat_<Value> > &values,
 void multi_img::setTo(const Pixel &p)
 {
 	assert(p.size() == size());
-	for (size_t i = 0; i < size(); ++i)
+	for (size_t i = 0; i < size(); ++i) {
+		detachBand(i, false);
 		bands[i].setTo(p[i]);
+	}
 }
 
 void multi_img::applyCache()
 {
 	for (unsigned int d = 0; d < size(); ++d) {
+		detachBand(d, false);
 		Band &dst = bands[d];
 		Band::iterator it;
 		unsigned int i;
@@ -314,47 +355,53 @@ void multi_img::applyCache()
 	anydirt = false;
 }
 
+/* number of histogram bins used to determine outlier bounds */
+static const int RANGE_BINS = 4096;
+
 multi_img::Range multi_img::data_range(double fraction) const
 {
 	assert(!empty());
 	assert(fraction < .5);
 
 	/*  find overall data range */
-	Range ret(bands[0](0,0), bands[0](0,0));
-	double tmp1, tmp2;
-	for (unsigned int d = 0; d < size(); ++d) {
-		cv::minMaxLoc(bands[d], &tmp1, &tmp2);
-		ret.min = std::min<Value>(ret.min, (Value)tmp1);
-		ret.max = std::max<Value>(ret.max, (Value)tmp2);
+	BandRanges bandranges(*this);
+	tbb::parallel_reduce(tbb::blocked_range<int>(0, height), bandranges);
+	const std::vector<Range> &ranges = bandranges.GetRanges();
+	Range ret = ranges[0];
+	for (size_t d = 1; d < size(); ++d) {
+		ret.min = std::min<Value>(ret.min, ranges[d].min);
+		ret.max = std::max<Value>(ret.max, ranges[d].max);
 	}
 
+	// no finite data at all
+	if (ret.min > ret.max)
+		return Range();
+
 	if (fraction == 0.) {
 		return ret;
 	}
 
-	/* we build a histogram to find "good" data range */
-	cv::Mat_<float> hist;
-	// todo: argument of the function?
-	int bins = 100;
-	int histSize[] = { bins };
-	float range1[] = { ret.min, ret.max };
-	const float *ranges[] = { range1 };
-	int channels[] = { 0 };
-
-	for (unsigned int d = 0; d < size(); ++d)
-		cv::calcHist(&bands[d], 1, channels, cv::Mat(), hist,
-					 1, histSize, ranges, true, d>0);
+	/* we build a histogram over the overall range to find "good" data
+	   range. Non-finite values are not counted. */
+	int bins = RANGE_BINS;
+	RangeHistogram histogram(*this, ret, bins);
+	tbb::parallel_reduce(tbb::blocked_range<int>(0, height), histogram);
+	const std::vector<size_t> &hist = histogram.GetHist();
+	size_t total = 0;
+	for (int i = 0; i < bins; ++i)
+		total += hist[i];
 
 	/* we defensively choose bin borders as new range approx. */
 	double binsize = (ret.max - ret.min)/(double)bins;
-	int needed = (int)std::ceil((double)(width*height*size())*fraction);
-	int found, index;
+	size_t needed = (size_t)std::ceil((double)total*fraction);
+	size_t found;
+	int index;
 
 	/* first: small values */
 	found = 0;
 	index = 0;
 	while (found < needed) {
-		found += (int)hist[index][0];
+		found += hist[index];
 		index++;
 	}
 	// set to lower boundary of last outlier bin
@@ -362,60 +409,42 @@ multi_img::Range multi_img::data_range(double fraction) const
 
 	/* second: large values */
 	found = 0;
-	index = hist.rows - 1;
+	index = bins - 1;
 	while (found < needed) {
-		found += (int)hist[index][0];
+		found += hist[index];
 		index--;
 	}
 	// set to upper boundary of last outlier bin
-	ret.max = ret.max - (Value)(binsize*(hist.rows - index - 2));
+	ret.max = ret.max - (Value)(binsize*(bins - index - 2));
 
 	return ret;
 }
 
-cv::PCA multi_img::pca(unsigned int components) const
+std::vector<multi_img::Range> multi_img::band_ranges() const
 {
-	assert(components <= size());
-
-	// make sure cache is there
-	rebuildPixels(true);
-
-	// create input matrix
-	cv::Mat_<Value> input(size(), (int)pixels.size());
-	for (size_t i = 0; i < pixels.size(); ++i) {
-		cv::Mat_<Value> in(pixels[i]);
-		cv::Mat_<Value> out(input.col((int)i));
-		in.copyTo(out);
+	BandRanges bandranges(*this);
+	tbb::parallel_reduce(tbb::blocked_range<int>(0, height), bandranges);
+	std::vector<Range> ret = bandranges.GetRanges();
+	// bands without finite data
+	for (size_t d = 0; d < ret.size(); ++d) {
+		if (ret[d].min > ret[d].max)
+			ret[d] = Range();
 	}
-
-	// perform PCA
-	cv::PCA ret(input, cv::noArray(), CV_PCA_DATA_AS_COL, (int)components);
 	return ret;
 }
 
-multi_img multi_img::project(const cv::PCA &pca) const
+cv::PCA multi_img::pca(unsigned int components) const
 {
-	multi_img ret(height, width, pca.eigenvectors.rows);
-
-	// make sure input cache is there
-	rebuildPixels(true);
-
-	// write
-	for (size_t i = 0; i < ret.pixels.size(); ++i) {
-		cv::Mat_<Value> input(pixels[i]);
-		cv::Mat_<Value> output(ret.pixels[i]);
-		pca.project(input, output);
-	}
-
-	// write back to band data
-	ret.applyCache();
+	assert(components <= size());
 
-	// set min/max as observed
-	Range range = ret.data_range();
-	ret.minval = range.min;
-	ret.maxval = range.max;
+	BandPCA ret;
+	ret.compute(*this, components);
+	return ret.pca();
+}
 
-	return ret;
+multi_img multi_img::project(const cv::PCA &pca) const
+{
+	return BandPCA(pca).project(*this);
 }
 
 multi_img::Pixel multi_img::project(const Pixel &p, const cv::PCA &pca)
@@ -443,6 +472,7 @@ multi_img::Pixel multi_img::backProject(const Pixel &p, const cv::PCA &pca)
 void multi_img::clamp()
 {
 	for (unsigned int d = 0; d < size(); ++d) {
+		detachBand(d);
 		Band &b = bands[d];
 		cv::max(b, minval, b);
 		cv::min(b, maxval, b);
@@ -458,6 +488,8 @@ void multi_img::data_rescale(Value newminval, Value newmaxval)
 
 	Value scale = (newmaxval - newminval)/(maxval - minval);
 	for (size_t d = 0; d < size(); ++d) {
+		// note: results are assigned in-place by OpenCV
+		detachBand(d);
 		Band &b = bands[d];
 		if (newminval == 0. && minval == 0.) {
 			b *= scale;
@@ -493,10 +525,11 @@ void multi_img::data_stretch_single(Value newmin, Value newmax)
 		minval = newmin;
 		maxval = newmax;
 	}
+	std::vector<Range> ranges = band_ranges();
 	for (size_t d = 0; d < size(); ++d) {
+		detachBand(d);
 		Band &b = bands[d];
-		double mi, ma;
-		cv::minMaxLoc(b, &mi, &ma);
+		double mi = ranges[d].min, ma = ranges[d].max;
 		double scale = (maxval - minval)/(ma - mi);
 
 		if (mi == 0. && minval == 0.) {
@@ -513,8 +546,10 @@ void multi_img::data_stretch_single(Value newmin, Value newmax)
 
 void multi_img::flip(int flipCode)
 {
-	for (size_t i = 0; i < size(); ++i)
+	for (size_t i = 0; i < size(); ++i) {
+		detachBand(i);
 		cv::flip(bands[i], bands[i], flipCode);
+	}
 
 	// cache became invalid
 	resetPixels();
@@ -552,6 +587,7 @@ void multi_img::normalize_magnitudes()
 void multi_img::apply_logarithm()
 {
 	for (size_t i = 0; i < size(); ++i) {
+		detachBand(i);
 		// will assign large negative value to 0 pixels
 		cv::log(bands[i], bands[i]);
 		// get rid of negative values (when pixel value was 0)
@@ -569,6 +605,7 @@ void multi_img::blur(cv::Size ksize, double sigmaX, double sigmaY,
 					 int borderType)
 {
 	for (size_t i = 0; i < size(); ++i) {
+		detachBand(i);
 		cv::GaussianBlur(bands[i], bands[i], ksize, sigmaX, sigmaY, borderType);
 	}
 	// cache became invalid
@@ -585,6 +622,22 @@ bool multi_img::empty() const
 	return bands.empty();
 }
 
+size_t multi_img::byteSize() const
+{
+	size_t ret = pixelBytes();
+	for (size_t d = 0; d < bands.size(); ++d)
+		ret += bands[d].total() * bands[d].elemSize();
+	return ret;
+}
+
+size_t multi_img::pixelBytes() const
+{
+	size_t ret = pixels.size() * sizeof(Pixel) + dirty.total();
+	for (size_t i = 0; i < pixels.size(); ++i)
+		ret += pixels[i].capacity() * sizeof(Value);
+	return ret;
+}
+
 void multi_img::getBand(size_t band, Band &data) const
 {
 	data = bands[band];
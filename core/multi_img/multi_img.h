@@ -31,13 +31,10 @@
 class Illuminant;
 
 // FIXME what a mess
-class Grad;
-class Log;
+class LogGrad;
 class NormL2;
 class Clamp;
-class Illumination;
-class PcaProjection;
-class MultiImg2BandMat;
+class BandPCA;
 class GradientCuda;
 class GradientTbb;
 class NormL2Tbb;
@@ -53,16 +50,15 @@ class PcaTbb;
 	friend class RebuildPixels;\
 	friend class ApplyCache;\
 	friend class DetermineRange;\
+	friend class BandRanges;\
+	friend class RangeHistogram;\
 	friend class Band2QImageTbb;\
 	friend class RescaleTbb;\
-	friend class Resize; \
-	friend class Grad;\
-	friend class Log;\
+	friend class BandResample;\
+	friend class LogGrad;\
 	friend class NormL2;\
 	friend class Clamp;\
-	friend class Illumination;\
-	friend class PcaProjection;\
-	friend class MultiImg2BandMat;\
+	friend class BandPCA;\
 	friend class GradientCuda;\
 	friend class GradientTbb;\
 	friend class NormL2Tbb;\
@@ -152,6 +148,17 @@ public:
 	/// returns the roi part of the given band
 	virtual void scopeBand(const Band &source, const cv::Rect &roi, Band &target) const = 0;
 
+	/// returns the roi part of one band, see getBand() and scopeBand()
+	virtual void getScopedBand(size_t band, const cv::Rect &roi, Band &data) const
+	{
+		Band full;
+		getBand(band, full);
+		scopeBand(full, roi, data);
+	}
+
+	/// approximate memory footprint of the image data in bytes
+	virtual size_t byteSize() const { return 0; }
+
 	/// minimum and maximum values (by data format, not actually observed data!)
 	Value minval, maxval;
 
@@ -231,7 +238,9 @@ public:
 	multi_img(int height, int width, unsigned int size);
 
 	/// copy constructor
-	/** @arg omitCache only copy the image data, but start with empty cache
+	/** Band data is shared with the original until either image alters it
+		(copy-on-write). The pixel cache is copied.
+		@arg omitCache only copy the image data, but start with empty cache
 	*/
 	multi_img(const multi_img &, bool omitCache = false);
 
@@ -242,7 +251,8 @@ public:
 	multi_img(const multi_img &a, unsigned int start, unsigned int end);
 
 	/// assignment operator
-	/** @note A copy of the image (including cache) is created **/
+	/** @note A copy of the image (including cache) is created, band data is
+		shared copy-on-write **/
 	multi_img & operator=(const multi_img &);
 
 	/** reads in and processes either
@@ -270,6 +280,12 @@ public:
 	/// returns true if image is uninitialized
 	virtual bool empty() const;
 
+	/// returns memory footprint of bands and pixel cache
+	virtual size_t byteSize() const;
+
+	/// returns memory footprint of the pixel cache
+	size_t pixelBytes() const;
+
 	/// returns one band
     virtual void getBand(size_t band, Band &data) const;
 
@@ -356,6 +372,15 @@ public:
 	/// rebuild a single pixel (inefficient if many pixels are processed)
 	void rebuildPixel(unsigned int row, unsigned int col) const;
 
+	/// free the pixel cache, it is rebuilt on access
+	/** Call rebuildPixels() before accessing many pixels. The cache must not
+		hold changes that are not applied to the bands yet (see applyCache).
+	*/
+	void releasePixels() const;
+
+	/// returns true if the pixel cache is (partly) outdated or released
+	bool pixelsDirty() const { return anydirt; }
+
 //@}
 
 /** @name Data export and conversion **/
@@ -411,9 +436,14 @@ public:
 	int read_mat(const cv::Mat &src);
 	/// add data from one cv::Mat with given source range, returns #channels
 	int read_mat(const cv::Mat &src, Value srcmin, Value srcmax);
+	/// convert one cv::Mat to bands of range [minval, maxval], helper
+	static void convert_mat(const cv::Mat &src, Value srcmin, Value srcmax,
+							Value minval, Value maxval,
+							std::vector<Band> &target);
 
 	/// compile image from filelist (files can have several channels)
-	// will not erase previous data
+	/** Files are decoded in parallel, bands are added in list order.
+		Will not erase previous data. */
 	void read_image(const std::vector<std::string> &files,
 					const std::vector<BandDesc> &descs = std::vector<BandDesc>());
 
@@ -447,10 +477,15 @@ public:
 	   @param fraction If this is > 0, histogramming is employed to
 	           find a range such as atmost fraction of the data values lie
 	           outside the range. This is useful to ignore outliers that
-	           would inordinately stretch the range.
+	           would inordinately stretch the range. The bounds are
+	           borders of a 4096-bin histogram over the data range.
+	   Non-finite values are ignored.
 	**/
 	Range data_range(double fraction = 0.) const;
 
+	/// determine minimum, maximum of observed finite data in each band
+	std::vector<Range> band_ranges() const;
+
 	/// compute PCA of the image
 	/**
 	  @param components number of components to compute (if 0, compute #bands)
@@ -522,6 +557,15 @@ public:
 
 	/// return a copy with fewer bands (linear interpolation)
     multi_img spec_rescale(unsigned int newsize) const;
+
+	/// matrix (newsize x oldsize) of linear interpolation between band counts
+	/** Multiplied with a spectrum, gives the result of spec_rescale(). */
+	static cv::Mat1f spec_rescale_weights(unsigned int oldsize,
+										  unsigned int newsize);
+
+	/// wavelength metadata interpolated accordingly to spec_rescale()
+	static std::vector<BandDesc> spec_rescale_meta(
+			const std::vector<BandDesc> &meta, unsigned int newsize);
 //@}
 
 /** @name Helper functions **/
@@ -546,6 +590,13 @@ public:
 
 	/// helper function to do conversion from xyz to sRGB color space
 	static void xyz2bgr(const cv::Vec3f &xyz, cv::Vec3f &rgb);
+
+	/// compute XYZ weights of each band (#bands x 3 matrix)
+	/** A row vector of pixel values multiplied with this matrix gives the
+		same result as pixel2xyz(). Use it to convert many pixels at once.
+	*/
+	static cv::Mat1f xyz_weights(const std::vector<BandDesc> &meta,
+								 Value maxval);
 //@}
 
 /** @name Illumination **/
@@ -564,6 +615,13 @@ protected:
 	/// write back pixel cache into band data
 	void applyCache();
 
+	/// true if band data is referenced elsewhere (other image, band header)
+	static bool isShared(const Band &band);
+
+	/// make band data exclusive to this image, needed before writing to it
+	/** @arg preserve keep content (otherwise band gets uninitialized data) */
+	void detachBand(size_t band, bool preserve = true);
+
 	/// simple data structure initialization
 	void init(int height, int width, unsigned int size,
 			  Value minval = MULTI_IMG_MIN_DEFAULT,
@@ -0,0 +1,88 @@
+#include "multi_img_compact.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <limits>
+
+/* quantizes the bands of a float image */
+class Quantize {
+public:
+	Quantize(const multi_img &source, std::vector<multi_img_compact::CompactBand> &target,
+			 multi_img::Value scale, multi_img::Value offset)
+		: source(source), target(target), scale(scale), offset(offset) {}
+
+	void operator()(const tbb::blocked_range<size_t> &r) const
+	{
+		for (size_t d = r.begin(); d != r.end(); ++d) {
+			// saturating conversion with rounding
+			source[d].convertTo(target[d], CV_16U, 1. / scale, -offset / scale);
+		}
+	}
+
+private:
+	const multi_img &source;
+	std::vector<multi_img_compact::CompactBand> &target;
+	multi_img::Value scale, offset;
+};
+
+multi_img_compact::multi_img_compact(const multi_img &source)
+	: multi_img_base(source), bands(source.size())
+{
+	/* quantize over the value range of the data format. Integer sources
+	   (range 0..255 or 0..65535 mapped onto the same range) map exactly. */
+	const Value levels = std::numeric_limits<unsigned short>::max();
+	Value s = (maxval - minval) / levels;
+	if (!(s > 0.f))
+		s = 1.f;
+	scale.assign(bands.size(), s);
+	offset.assign(bands.size(), minval);
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, bands.size()),
+					  Quantize(source, bands, s, minval));
+}
+
+size_t multi_img_compact::size() const
+{
+	return bands.size();
+}
+
+bool multi_img_compact::empty() const
+{
+	return bands.empty();
+}
+
+size_t multi_img_compact::byteSize() const
+{
+	size_t ret = 0;
+	for (size_t d = 0; d < bands.size(); ++d)
+		ret += bands[d].total() * bands[d].elemSize();
+	return ret;
+}
+
+void multi_img_compact::getBand(size_t band, Band &data) const
+{
+	Band tmp;
+	bands[band].convertTo(tmp, ValueType, scale[band], offset[band]);
+	data = tmp;
+}
+
+void multi_img_compact::scopeBand(const Band &source, const cv::Rect &roi, Band &target) const
+{
+	Band scoped(source, roi);
+	target = scoped.clone();
+}
+
+void multi_img_compact::getScopedBand(size_t band, const cv::Rect &roi, Band &data) const
+{
+	Band tmp;
+	CompactBand(bands[band], roi).convertTo(tmp, ValueType,
+											scale[band], offset[band]);
+	data = tmp;
+}
+
+void multi_img_compact::scaleBand(size_t band, Value factor)
+{
+	scale[band] *= factor;
+	offset[band] *= factor;
+}
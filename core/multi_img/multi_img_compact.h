@@ -0,0 +1,53 @@
+#ifndef MULTI_IMG_COMPACT_H
+#define MULTI_IMG_COMPACT_H
+
+#include <multi_img.h>
+
+/// multi_img with limited functionality and 16 bit band storage
+/**
+	Each band is quantized linearly to unsigned 16 bit integers, halving the
+	memory footprint of the float representation. Bands are widened to Value
+	on access. Data originating from 8 or 16 bit sources is stored losslessly,
+	floating point data with a precision of 1/65535 of the value range.
+ */
+class multi_img_compact : public multi_img_base {
+public:
+	/// quantized spectral band
+	typedef cv::Mat_<unsigned short> CompactBand;
+
+	/// creates a compact copy of the given image (without pixel cache)
+	explicit multi_img_compact(const multi_img &source);
+
+	/// virtual destructor, does nothing
+	virtual ~multi_img_compact() {}
+
+	/// returns number of bands
+	virtual size_t size() const;
+
+	/// returns true if image is uninitialized
+	virtual bool empty() const;
+
+	/// returns memory footprint of the band data
+	virtual size_t byteSize() const;
+
+	/// returns one band (widened copy)
+	virtual void getBand(size_t band, Band &data) const;
+
+	/// returns the roi part of the given band
+	virtual void scopeBand(const Band &source, const cv::Rect &roi, Band &target) const;
+
+	/// returns the roi part of one band, only the roi is widened
+	virtual void getScopedBand(size_t band, const cv::Rect &roi, Band &data) const;
+
+	/// multiply one band by a factor, only the quantization is altered
+	void scaleBand(size_t band, Value factor);
+
+protected:
+	std::vector<CompactBand> bands;
+	/// per-band quantization: value = offset + scale * quantized value
+	std::vector<Value> scale, offset;
+
+	MULTI_IMG_FRIENDS
+};
+
+#endif // MULTI_IMG_COMPACT_H
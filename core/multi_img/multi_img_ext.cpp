@@ -9,6 +9,10 @@
 #include <multi_img.h>
 #include "illuminant.h"
 #include "cieobserver.h"
+#include "colortransform.h"
+#include "multi_img_tbb.h"
+
+#include <tbb/parallel_for.h>
 
 #include <mmintrin.h>
 #include <xmmintrin.h>
@@ -44,33 +48,47 @@ multi_img multi_img::spec_rescale(unsigned int newsize) const
 	ret.minval = minval;
 	ret.maxval = maxval;
 
-	rebuildPixels();
-	for (int row = 0; row < height; ++row) {
-		for (int col = 0; col < width; ++col) {
-			/// delegate resizing to opencv, using mat headers over vectors
-			cv::Mat_<Value> src(pixels[row*width + col]),
-			                dst(ret.pixels[row*width + col]);
-			cv::resize(src, dst, cv::Size(1, newsize));
-		}
+	/// each new band is a weighted sum of (typically two) old bands
+	cv::Mat1f weights = spec_rescale_weights(size(), newsize);
+	BandResample resample(*this, ret, weights);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, newsize), resample);
+
+	ret.meta = spec_rescale_meta(meta, newsize);
+
+	return ret;
+}
+
+std::vector<multi_img::BandDesc> multi_img::spec_rescale_meta(
+		const std::vector<BandDesc> &meta, unsigned int newsize)
+{
+	cv::Mat_<float> tmpmeta1(cv::Size(meta.size(), 1)), tmpmeta2;
+	std::vector<BandDesc>::const_iterator it;
+	unsigned int i;
+	for (it = meta.begin(), i = 0; it != meta.end(); it++, i++) {
+		tmpmeta1(0, i) = it->center;
 	}
+	cv::resize(tmpmeta1, tmpmeta2, cv::Size(newsize, 1));
 
-	/// ret: write back pixel cache into bands
-	ret.applyCache();
-
-	/// interpolate wavelength metadata accordingly
-	{
-		cv::Mat_<float> tmpmeta1(cv::Size(meta.size(), 1)), tmpmeta2;
-		std::vector<BandDesc>::const_iterator it;
-		unsigned int i;
-		for (it = meta.begin(), i = 0; it != meta.end(); it++, i++) {
-			tmpmeta1(0, i) = it->center;
-		}
-		cv::resize(tmpmeta1, tmpmeta2, cv::Size(newsize, 1));
-		for (size_t b = 0; b < newsize; b++) {
-			ret.meta[b] = BandDesc(tmpmeta2(0, b));
-		}
+	std::vector<BandDesc> ret(newsize);
+	for (size_t b = 0; b < newsize; b++) {
+		ret[b] = BandDesc(tmpmeta2(0, b));
 	}
+	return ret;
+}
 
+cv::Mat1f multi_img::spec_rescale_weights(unsigned int oldsize,
+										  unsigned int newsize)
+{
+	/* cv::resize is linear in its input, so resizing the unit vectors yields
+	   the columns of the interpolation matrix */
+	cv::Mat1f ret(newsize, oldsize);
+	cv::Mat1f unit(oldsize, 1, 0.f), column;
+	for (unsigned int i = 0; i < oldsize; ++i) {
+		unit(i) = 1.f;
+		cv::resize(unit, column, cv::Size(1, newsize));
+		column.copyTo(ret.col(i));
+		unit(i) = 0.f;
+	}
 	return ret;
 }
 
@@ -120,6 +138,28 @@ void multi_img::pixel2xyz(const Pixel &p, cv::Vec3f &v) const
 	pixel2xyz(p, v, p.size(), meta, maxval);
 }
 
+cv::Mat1f multi_img::xyz_weights(const std::vector<BandDesc> &meta,
+								  Value maxval)
+{
+	cv::Mat1f ret(meta.size(), 3, 0.f);
+	float greensum = 0.f;
+	for (size_t i = 0; i < meta.size(); ++i) {
+		int idx = ((int)(meta[i].center + 0.5f) - 360) / 5;
+		if (idx < 0 || idx > 94)
+			continue;
+		ret(i, 0) = CIEObserver::x[idx];
+		ret(i, 1) = CIEObserver::y[idx];
+		ret(i, 2) = CIEObserver::z[idx];
+		greensum += CIEObserver::y[idx];
+	}
+	// see pixel2xyz(): without valuable data, the result is zero anyway
+	if (greensum == 0.f)
+		greensum = 1.f;
+
+	ret *= 1.f / (maxval * greensum);
+	return ret;
+}
+
 void multi_img::xyz2bgr(const cv::Vec3f &vs, cv::Vec3f &vd)
 {
 	/* Inverse M for sRGB, D65 */
@@ -171,38 +211,7 @@ void multi_img::xyz2bgr(const cv::Vec3f &vs, cv::Vec3f &vd)
 
 cv::Mat_<cv::Vec3f> multi_img::bgr() const
 {
-	cv::Mat_<cv::Vec3f> xyz(height, width, 0.);
-	float greensum = 0.f;
-	for (size_t i = 0; i < size(); ++i) {
-		int idx = ((int)(meta[i].center + 0.5f) - 360) / 5;
-		if (idx < 0 || idx > 94)
-			continue;
-		Band::const_iterator src = bands[i].begin();
-		cv::Mat_<cv::Vec3f>::iterator dst = xyz.begin();
-		for (; dst != xyz.end(); ++src, ++dst) {
-			cv::Vec3f &v = *dst;
-			float intensity = (*src) * 1.f/maxval;
-			v[0] += CIEObserver::x[idx] * intensity;
-			v[1] += CIEObserver::y[idx] * intensity;
-			v[2] += CIEObserver::z[idx] * intensity;
-		}
-		greensum += CIEObserver::y[idx];
-	}
-
-	if (greensum == 0.f)
-		greensum = 1.f;
-
-	cv::Mat_<cv::Vec3f> bgr(height, width);
-	cv::Mat_<cv::Vec3f>::iterator src = xyz.begin();
-	cv::Mat_<cv::Vec3f>::iterator dst = bgr.begin();
-	for (; dst != bgr.end(); ++src, ++dst) {
-		cv::Vec3f &vs = *src;
-		cv::Vec3f &vd = *dst;
-		for (unsigned int i = 0; i < 3; ++i)
-			vs[i] /= greensum;
-		xyz2bgr(vs, vd);
-	}
-	return bgr;
+	return ColorTransform(meta, maxval).bgr(*this);
 }
 
 cv::Vec3f multi_img::bgr(const Pixel &p) const
@@ -224,6 +233,9 @@ cv::Vec3f multi_img::bgr(const Pixel &p,
 
 void multi_img::apply_illuminant(const Illuminant& il, bool remove)
 {
+	for (size_t i = 0; i < size(); ++i)
+		detachBand(i);
+
 	if (remove) {
 		for (size_t i = 0; i < size(); ++i)
 			bands[i] /= (Value)il.at(meta[i].center);
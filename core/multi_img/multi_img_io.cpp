@@ -12,6 +12,9 @@
 #include "qtopencv.h"
 
 #include <opencv2/highgui/highgui.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/tick_count.h>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -49,20 +52,24 @@ QImage multi_img::export_qt(unsigned int band) const
 }
 #endif
 
-// read image part (what fits into one cv::Mat)
-int multi_img::read_mat(const cv::Mat &src)
+// maximum of original data range, while we assume minimum is 0
+static multi_img::Value source_maxval(const cv::Mat &src)
 {
-	// find maximum of original data range, while we assume minimum is 0
-	Value srcmaxval = 0.;
 	// we expect CV_8U, CV_16U or floating point in [0..1]
 	switch (src.depth()) {
-		case CV_8U:	 { srcmaxval = 255.; break; }
-		case CV_16U: { srcmaxval = 65535.; break; }
+		case CV_8U:	 return 255.;
+		case CV_16U: return 65535.;
 		case CV_32F:
-		case CV_64F: { srcmaxval = 1.; break; }
+		case CV_64F: return 1.;
 		default:	assert(42 == 0);	// we don't handle other formats so far!
 	}
-	return read_mat(src, 0., srcmaxval);
+	return 0.;
+}
+
+// read image part (what fits into one cv::Mat)
+int multi_img::read_mat(const cv::Mat &src)
+{
+	return read_mat(src, 0., source_maxval(src));
 }
 
 // read image part (what fits into one cv::Mat)
@@ -77,6 +84,17 @@ int multi_img::read_mat(const cv::Mat &src, Value srcminval, Value srcmaxval)
 	width = src.cols;
 	height = src.rows;
 
+	// add everything in at the end
+	std::vector<Band> channels;
+	convert_mat(src, srcminval, srcmaxval, minval, maxval, channels);
+	bands.insert(bands.end(), channels.begin(), channels.end());
+	return channels.size();
+}
+
+void multi_img::convert_mat(const cv::Mat &src, Value srcminval,
+							Value srcmaxval, Value minval, Value maxval,
+							std::vector<Band> &target)
+{
 	// convert to right datatype, scaling
 	cv::Mat tmp;
 	src.convertTo(tmp, ValueType);
@@ -91,50 +109,111 @@ int multi_img::read_mat(const cv::Mat &src, Value srcminval, Value srcmaxval)
 		if (minval != 0.)
 			tmp += minval;
 	}
-	
-	// split & add everything in at the end
+
+	// split
 	size_t cc = tmp.channels();
 	if (cc > 1) {
-		std::vector<Band> channels(cc);
-		cv::split(tmp, channels);
-		bands.insert(bands.end(), channels.begin(), channels.end());
+		target.resize(cc);
+		cv::split(tmp, target);
 	} else {
-		bands.push_back(tmp);
+		target.assign(1, tmp);
 	}
-	return cc;
 }
 
+/* decodes files into their slots, converted to bands */
+class DecodeFiles {
+public:
+	struct Slot {
+		Slot() : width(0), height(0), depth(0), seconds(0.) {}
+		std::vector<multi_img::Band> bands;
+		// properties of the source file
+		int width, height, depth;
+		// time spent on decoding and conversion
+		double seconds;
+	};
+
+	DecodeFiles(const std::vector<std::string> &files,
+				multi_img::Value minval, multi_img::Value maxval,
+				std::vector<Slot> &slots)
+		: files(files), minval(minval), maxval(maxval), slots(slots) {}
+
+	void operator()(const tbb::blocked_range<size_t> &r) const
+	{
+		for (size_t fi = r.begin(); fi != r.end(); ++fi) {
+			tbb::tick_count start = tbb::tick_count::now();
+			cv::Mat src = cv::imread(files[fi], -1); // flag -1: preserve format
+			if (src.empty())
+				continue;
+
+			Slot &slot = slots[fi];
+			slot.width = src.cols;
+			slot.height = src.rows;
+			slot.depth = src.depth();
+			multi_img::convert_mat(src, 0., source_maxval(src),
+								   minval, maxval, slot.bands);
+			slot.seconds = (tbb::tick_count::now() - start).seconds();
+		}
+	}
+
+private:
+	const std::vector<std::string> &files;
+	multi_img::Value minval, maxval;
+	std::vector<Slot> &slots;
+};
+
 // read multires. image into vector
 void multi_img::read_image(const std::vector<std::string> &files,
 						   const std::vector<BandDesc> &descs)
 {
 	int channels = 0;
-	
-	for (size_t fi = 0; fi < files.size(); ++fi) {
-	    cv::Mat src = cv::imread(files[fi], -1); // flag -1: preserve format
 
-		if (src.empty()) {
+	if (minval == maxval) { // i.e. uninitialized
+		/* default to our favorite range */
+		minval = MULTI_IMG_MIN_DEFAULT; maxval = MULTI_IMG_MAX_DEFAULT;
+	}
+
+	/* decode concurrently, files are large and decoding (zlib) dominates.
+	   One file per task as file sizes vary little. */
+	std::vector<DecodeFiles::Slot> slots(files.size());
+	tbb::tick_count start = tbb::tick_count::now();
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, files.size(), 1),
+					  DecodeFiles(files, minval, maxval, slots));
+	double seconds = (tbb::tick_count::now() - start).seconds();
+
+	// add bands in list order, releasing slots as we go
+	for (size_t fi = 0; fi < files.size(); ++fi) {
+		DecodeFiles::Slot &slot = slots[fi];
+		if (slot.bands.empty()) {
 			std::cerr << "ERROR: Failed to load " << files[fi] << std::endl;
 			continue;
 		}
 
 		// test spatial size
-		if (width > 0 && (src.cols != width || src.rows != height)) {
+		if (width > 0 && (slot.width != width || slot.height != height)) {
 			std::cerr << "ERROR: Size mismatch for image " << files[fi]
 						 << std::endl;
+			std::vector<Band>().swap(slot.bands);
 			continue;
 		}
 
-		channels = read_mat(src);
-		
+		width = slot.width;
+		height = slot.height;
+		channels = slot.bands.size();
+		bands.insert(bands.end(), slot.bands.begin(), slot.bands.end());
+		std::vector<Band>().swap(slot.bands);
+
 		std::cerr << "Added " << files[fi] << ":\t" << channels
              << (channels == 1 ? " channel, " : " channels, ")
-			 << (src.depth() == CV_16U ? 16 : 8) << " bits";
+			 << (slot.depth == CV_16U ? 16 : 8) << " bits, "
+			 << slot.seconds * 1000. << " ms";
 		if (descs.empty() || descs[fi].empty)
 			std::cerr << std::endl;
 		else
 			std::cerr << ", " << descs[fi].center << " nm" << std::endl;
 	}
+	if (files.size() > 1)
+		std::cerr << "Decoded " << files.size() << " files in "
+				  << seconds * 1000. << " ms" << std::endl;
 
 	/* invalidate pixel cache as pixel length has changed
 	   This step is _mandatory_ also to initialize cache containers */
@@ -1,4 +1,5 @@
 #include "multi_img_offloaded.h"
+#include "imageprobe.h"
 #include <opencv2/highgui/highgui.hpp>
 
 multi_img_offloaded::multi_img_offloaded(const std::vector<std::string> &files,
@@ -9,42 +10,44 @@ multi_img_offloaded::multi_img_offloaded(const std::vector<std::string> &files,
 	height = 0;
 
 	for (size_t fi = 0; fi < files.size(); ++fi) {
-		cv::Mat src = cv::imread(files[fi], -1); // flag -1: preserve format
-
-		if (src.empty()) {
-			std::cerr << "ERROR: Failed to load " << files[fi] << std::endl;
-			continue;
+		/* only read the header, pixel data is loaded on demand. Fall back to
+		   decoding for formats the probe does not handle. */
+		ImageHeader src;
+		if (!probeImageHeader(files[fi], src)) {
+			cv::Mat img = cv::imread(files[fi], -1); // flag -1: preserve format
+			if (img.empty()) {
+				std::cerr << "ERROR: Failed to load " << files[fi] << std::endl;
+				continue;
+			}
+			src.width = img.cols;
+			src.height = img.rows;
+			src.channels = img.channels();
+			src.depth = img.depth();
 		}
 
 		// test spatial size
-		if (width > 0 && (src.cols != width || src.rows != height)) {
+		if (width > 0 && (src.width != width || src.height != height)) {
 			std::cerr << "ERROR: Size mismatch for image "
 					  << files[fi] << std::endl;
 			continue;
 		}
 
 		// set spatial size
-		width = src.cols;
-		height = src.rows;
+		width = src.width;
+		height = src.height;
 
 		/* default to our favorite range */
 		minval = MULTI_IMG_MIN_DEFAULT;
 		maxval = MULTI_IMG_MAX_DEFAULT;
 
-		// split & add everything in at the end
-		channels = src.channels();
-		if (channels > 1) {
-			std::vector<cv::Mat> splitted(channels);
-			cv::split(src, splitted);
-			for (size_t c = 0; c < splitted.size(); ++c)
-				bands.push_back(std::make_pair(files[fi], c));
-		} else {
-			bands.push_back(std::make_pair(files[fi], 0));
-		}
+		// add one band per channel
+		channels = src.channels;
+		for (int c = 0; c < channels; ++c)
+			bands.push_back(std::make_pair(files[fi], c));
 
 		std::cout << "Added " << files[fi] << ":\t" << channels
 			 << (channels == 1 ? " channel, " : " channels, ")
-			 << (src.depth() == CV_16U ? 16 : 8) << " bits";
+			 << (src.depth == CV_16U ? 16 : 8) << " bits";
 		if (descs.empty() || descs[fi].empty)
 			std::cout << std::endl;
 		else
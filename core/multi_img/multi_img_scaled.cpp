@@ -0,0 +1,61 @@
+#include "multi_img_scaled.h"
+
+multi_img_scaled::multi_img_scaled(const multi_img &source,
+								   const std::vector<Value> &factors)
+	: multi_img_base(source), bands(source.size()), factors(factors)
+{
+	assert(factors.size() == source.size());
+	for (size_t d = 0; d < bands.size(); ++d)
+		source.getBand(d, bands[d]); // shares data
+}
+
+multi_img_scaled::multi_img_scaled(const multi_img_scaled &source,
+								   const std::vector<Value> &factors)
+	: multi_img_base(source), bands(source.bands), factors(source.factors)
+{
+	assert(factors.size() == source.size());
+	for (size_t d = 0; d < this->factors.size(); ++d)
+		this->factors[d] *= factors[d];
+}
+
+size_t multi_img_scaled::size() const
+{
+	return bands.size();
+}
+
+bool multi_img_scaled::empty() const
+{
+	return bands.empty();
+}
+
+size_t multi_img_scaled::byteSize() const
+{
+	size_t ret = 0;
+	for (size_t d = 0; d < bands.size(); ++d)
+		ret += bands[d].total() * bands[d].elemSize();
+	return ret;
+}
+
+void multi_img_scaled::getBand(size_t band, Band &data) const
+{
+	if (factors[band] == 1.f) {
+		data = bands[band];
+		return;
+	}
+	Band tmp;
+	bands[band].convertTo(tmp, ValueType, factors[band]);
+	data = tmp;
+}
+
+void multi_img_scaled::scopeBand(const Band &source, const cv::Rect &roi, Band &target) const
+{
+	Band scoped(source, roi);
+	target = scoped.clone();
+}
+
+void multi_img_scaled::getScopedBand(size_t band, const cv::Rect &roi, Band &data) const
+{
+	Band tmp;
+	Band(bands[band], roi).convertTo(tmp, ValueType, factors[band]);
+	data = tmp;
+}
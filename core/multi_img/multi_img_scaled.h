@@ -0,0 +1,50 @@
+#ifndef MULTI_IMG_SCALED_H
+#define MULTI_IMG_SCALED_H
+
+#include <multi_img.h>
+
+/// multi_img with limited functionality where each band is scaled by a factor
+/**
+	The view shares the band data of its source image; factors are applied
+	lazily whenever a band or a part of it is accessed. This is used to apply
+	an illuminant to the full image without copying it.
+ */
+class multi_img_scaled : public multi_img_base {
+public:
+	/// creates a view on the bands of source, multiplied by factors
+	multi_img_scaled(const multi_img &source, const std::vector<Value> &factors);
+
+	/// creates a view on the source of another view, factors are combined
+	multi_img_scaled(const multi_img_scaled &source,
+					 const std::vector<Value> &factors);
+
+	/// virtual destructor, does nothing
+	virtual ~multi_img_scaled() {}
+
+	/// returns number of bands
+	virtual size_t size() const;
+
+	/// returns true if image is uninitialized
+	virtual bool empty() const;
+
+	/// returns memory footprint of the band data
+	virtual size_t byteSize() const;
+
+	/// returns one band (scaled copy, or shared data if factor is one)
+	virtual void getBand(size_t band, Band &data) const;
+
+	/// returns the roi part of the given band
+	virtual void scopeBand(const Band &source, const cv::Rect &roi, Band &target) const;
+
+	/// returns the roi part of one band, only the roi is scaled
+	virtual void getScopedBand(size_t band, const cv::Rect &roi, Band &data) const;
+
+protected:
+	/// unscaled band data, shared with the source image
+	std::vector<Band> bands;
+	std::vector<Value> factors;
+
+	MULTI_IMG_FRIENDS
+};
+
+#endif // MULTI_IMG_SCALED_H
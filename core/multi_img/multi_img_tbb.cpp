@@ -3,14 +3,17 @@
 
 #include <multi_img.h>
 #include <multi_img/illuminant.h>
+#include <trace.h>
 
 #include <opencv2/core/core.hpp>
 #include <tbb/parallel_for.h>
 #include <cstddef>
+#include <cmath>
 #include <algorithm>
 
 void RebuildPixels::operator()(const tbb::blocked_range<size_t> &r) const
 {
+	TRACE_SPAN("RebuildPixels", "tbb");
 	for (size_t d = r.begin(); d != r.end(); ++d) {
 		multi_img::Band &src = multi.bands[d];
 		if (src.empty()) {
@@ -24,6 +27,7 @@ void RebuildPixels::operator()(const tbb::blocked_range<size_t> &r) const
 
 void RebuildPixels::operator()(const tbb::blocked_range2d<int> &r) const
 {
+	TRACE_SPAN("RebuildPixels", "tbb");
 	for (int row = r.rows().begin(); row != r.rows().end(); ++row) {
 		int loc = row * multi.width;
 		for (int col = r.cols().begin(); col != r.cols().end(); ++col) {
@@ -35,7 +39,9 @@ void RebuildPixels::operator()(const tbb::blocked_range2d<int> &r) const
 
 void ApplyCache::operator()(const tbb::blocked_range<size_t> &r) const
 {
+	TRACE_SPAN("ApplyCache", "tbb");
 	for (size_t d = r.begin(); d != r.end(); ++d) {
+		multi.detachBand(d, false);
 		multi_img::Band &dst = multi.bands[d];
 		multi_img::Band::iterator it; size_t i;
 		for (it = dst.begin(), i = 0; it != dst.end(); ++it, ++i)
@@ -43,8 +49,11 @@ void ApplyCache::operator()(const tbb::blocked_range<size_t> &r) const
 	}
 }
 
+/* regions of one band are written concurrently, so bands cannot be detached
+   here. Callers need to ensure band data is not shared. */
 void ApplyCache::operator()(const tbb::blocked_range2d<int> &r) const
 {
+	TRACE_SPAN("ApplyCache", "tbb");
 	for (int row = r.rows().begin(); row != r.rows().end(); ++row) {
 		int loc = row * multi.width;
 		for (int col = r.cols().begin(); col != r.cols().end(); ++col) {
@@ -56,6 +65,7 @@ void ApplyCache::operator()(const tbb::blocked_range2d<int> &r) const
 
 void DetermineRange::operator()(const tbb::blocked_range<size_t> &r)
 {
+	TRACE_SPAN("DetermineRange", "tbb");
 	double tmp1, tmp2;
 	for (size_t d = r.begin(); d != r.end(); ++d) {
 		cv::minMaxLoc(multi.bands[d], &tmp1, &tmp2);
@@ -72,88 +82,90 @@ void DetermineRange::join(DetermineRange &toJoin)
 		max = toJoin.max;
 }
 
-
-void Xyz::operator()(const tbb::blocked_range2d<int> &r) const
-{
-	float intensity;
-	float factor = 1.f / multi.maxval;
-	__m128 cie_reg = _mm_setr_ps(CIEObserver::x[cie], 0.f,
-	                             CIEObserver::y[cie], CIEObserver::z[cie]);
-
-	for (int i = r.rows().begin(); i != r.rows().end(); ++i) {
-		for (int j = r.cols().begin(); j != r.cols().end(); ++j) {
-			/*
-			cv::Vec3f &v = xyz(i, j);
-			float intensity = band(i, j) * 1.f / multi.maxval;
-			v[0] += CIEObserver::x[cie] * intensity;
-			v[1] += CIEObserver::y[cie] * intensity;
-			v[2] += CIEObserver::z[cie] * intensity;
-			*/
-
-			cv::Vec3f &v = xyz(i, j);
-			intensity = band(i, j) * factor;
-			__m128 v_reg = _mm_loadh_pi(_mm_load_ss(&v[0]), (__m64*)&v[1]);
-			__m128 res_reg = _mm_add_ps(v_reg,
-			                            _mm_mul_ps(cie_reg,
-			                                       _mm_load1_ps(&intensity)));
-			_mm_storeh_pi((__m64*)&v[1], res_reg);
-			_mm_store_ss(&v[0], res_reg);
+void BandRanges::operator()(const tbb::blocked_range<int> &r)
+{
+	TRACE_SPAN("BandRanges", "tbb");
+	for (size_t d = 0; d < multi.size(); ++d) {
+		const multi_img::Band &band = multi.bands[d];
+		multi_img::Value mi = ranges[d].min, ma = ranges[d].max;
+		for (int y = r.begin(); y != r.end(); ++y) {
+			const multi_img::Value *row = band[y];
+			for (int x = 0; x < band.cols; ++x) {
+				multi_img::Value v = row[x];
+				if (!std::isfinite(v))
+					continue;
+				mi = std::min(mi, v);
+				ma = std::max(ma, v);
+			}
 		}
+		ranges[d] = multi_img::Range(mi, ma);
 	}
 }
 
-
-void Bgr::operator()(const tbb::blocked_range2d<int> &r) const
+void BandRanges::join(BandRanges &toJoin)
 {
-	for (int i = r.rows().begin(); i != r.rows().end(); ++i) {
-		for (int j = r.cols().begin(); j != r.cols().end(); ++j) {
-			/*
-			cv::Vec3f &vs = xyz(i, j);
-			cv::Vec3f &vd = bgr(i, j);
-			for (unsigned int j = 0; j < 3; ++j)
-				vs[j] /= greensum;
-			multi.xyz2bgr(vs, vd);
-			*/
-
-			cv::Vec3f &vs = xyz(i, j);
-			cv::Vec3f &vd = bgr(i, j);
-			__m128 vs_reg = _mm_loadh_pi(_mm_load_ss(&vs[0]), (__m64*)&vs[1]);
-			__m128 res_reg = _mm_div_ps(vs_reg, _mm_load1_ps(&greensum));
-			_mm_storeh_pi((__m64*)&vs[1], res_reg);
-			_mm_store_ss(&vs[0], res_reg);
-			multi_img::xyz2bgr(vs, vd);
-		}
+	for (size_t d = 0; d < ranges.size(); ++d) {
+		ranges[d].min = std::min(ranges[d].min, toJoin.ranges[d].min);
+		ranges[d].max = std::max(ranges[d].max, toJoin.ranges[d].max);
 	}
 }
 
-
-
-void Grad::operator ()(const tbb::blocked_range<size_t> &r) const
-{
-	for (size_t i = r.begin(); i != r.end(); ++i) {
-		//target.bands[i] = source.bands[i + 1] - source.bands[i];
-		cv::subtract(source.bands[i + 1], source.bands[i], target.bands[i]);
-		if (!source.meta[i].empty && !source.meta[i + 1].empty) {
-			target.meta[i] = multi_img::BandDesc(
-				source.meta[i].center, source.meta[i + 1].center);
+void RangeHistogram::operator()(const tbb::blocked_range<int> &r)
+{
+	TRACE_SPAN("RangeHistogram", "tbb");
+	const int bins = (int)hist.size();
+	const double mi = range.min;
+	const double scale = (range.max > range.min ?
+						  bins / ((double)range.max - mi) : 0.);
+	for (size_t d = 0; d < multi.size(); ++d) {
+		const multi_img::Band &band = multi.bands[d];
+		for (int y = r.begin(); y != r.end(); ++y) {
+			const multi_img::Value *row = band[y];
+			for (int x = 0; x < band.cols; ++x) {
+				multi_img::Value v = row[x];
+				if (!std::isfinite(v))
+					continue;
+				int i = (int)((v - mi) * scale);
+				++hist[std::max(0, std::min(i, bins - 1))];
+			}
 		}
 	}
 }
 
+void RangeHistogram::join(RangeHistogram &toJoin)
+{
+	for (size_t i = 0; i < hist.size(); ++i)
+		hist[i] += toJoin.hist[i];
+}
 
-void Log::operator ()(const tbb::blocked_range<size_t> &r) const
+/* logarithm of one row, getting rid of negative values (value was < 1) */
+static inline void logRow(const multi_img::Band &band, int y,
+						  const cv::Range &cols, cv::Mat1f &out)
 {
-	{
-		for (size_t i = r.begin(); i != r.end(); ++i) {
-			cv::log(source.bands[i], target.bands[i]);
-			//target.bands[i] = cv::max(target.bands[i], 0.);
-			cv::max(target.bands[i], 0., target.bands[i]);
+	cv::log(band.row(y).colRange(cols), out);
+	cv::max(out, 0., out);
+}
+
+void LogGrad::operator()(const tbb::blocked_range2d<int> &r) const
+{
+	TRACE_SPAN("LogGrad", "tbb");
+	const cv::Range cols(region.x, region.x + region.width);
+	cv::Mat1f prev, cur;
+	for (int y = region.y + r.cols().begin();
+		 y != region.y + r.cols().end(); ++y) {
+		logRow(source.bands[r.rows().begin()], y, cols, prev);
+		for (int b = r.rows().begin(); b != r.rows().end(); ++b) {
+			logRow(source.bands[b + 1], y, cols, cur);
+			multi_img::Band dst = target.bands[b].row(y).colRange(cols);
+			cv::subtract(cur, prev, dst);
+			std::swap(prev, cur);
 		}
 	}
 }
 
 void NormL2::operator()(const tbb::blocked_range2d<int> &r) const
 {
+	TRACE_SPAN("NormL2", "tbb");
 	for (int row = r.rows().begin(); row != r.rows().end(); ++row) {
 		for (int col = r.cols().begin(); col != r.cols().end(); ++col) {
 			cv::Mat_<multi_img::Value> src(
@@ -178,53 +190,31 @@ void Clamp::operator ()(const tbb::blocked_range<size_t> &r) const
 	}
 }
 
-void Illumination::operator ()(const tbb::blocked_range<size_t> &r) const
-{
-   if (remove) {
-	   for (size_t d = r.begin(); d != r.end(); ++d) {
-		   multi_img::Band &src = source.bands[d];
-		   multi_img::Band &tgt = target.bands[d];
-		   tgt = src / (multi_img::Value)il.at(source.meta[d].center);
-	   }
-   } else {
-	   for (size_t d = r.begin(); d != r.end(); ++d) {
-		   multi_img::Band &src = source.bands[d];
-		   multi_img::Band &tgt = target.bands[d];
-		   tgt = src * (multi_img::Value)il.at(source.meta[d].center);
-	   }
-   }
-}
-
-
-void PcaProjection::operator ()(const tbb::blocked_range<size_t> &r) const
-{
-	for (size_t i = r.begin(); i != r.end(); ++i) {
-		cv::Mat_<multi_img::Value> input = source.col(i);
-		cv::Mat_<multi_img::Value> output(target.pixels[i], false);
-		pca.project(input, output);
-	}
-}
-
-
-void MultiImg2BandMat::operator ()(const tbb::blocked_range<size_t> &r) const
+void BandResample::operator()(const tbb::blocked_range<size_t> &r) const
 {
+	TRACE_SPAN("BandResample", "tbb");
+	std::vector<int> taps;
 	for (size_t d = r.begin(); d != r.end(); ++d) {
-		multi_img::Band &src = source.bands[d];
-		multi_img::Band::const_iterator it; size_t i;
-		for (it = src.begin(), i = 0; it != src.end(); ++it, ++i)
-			target(d, i) = *it;
-	}
-}
+		// linear interpolation: typically one or two contributing bands
+		const float *w = weights[d];
+		taps.clear();
+		for (int i = 0; i < weights.cols; ++i) {
+			if (w[i] != 0.f)
+				taps.push_back(i);
+		}
 
-void Resize::operator()(const tbb::blocked_range2d<int> &r) const
-{
-	for (int row = r.rows().begin(); row != r.rows().end(); ++row) {
-		for (int col = r.cols().begin(); col != r.cols().end(); ++col) {
-			cv::Mat_<multi_img::Value> src(
-			            source.pixels[row * source.width + col], false);
-			cv::Mat_<multi_img::Value> dst(
-			            target.pixels[row * source.width + col], false);
-			cv::resize(src, dst, cv::Size(1, newsize));
+		multi_img::Band &tgt = target.bands[d];
+		if (taps.empty()) {
+			tgt.setTo(0.);
+			continue;
+		}
+		if (taps.size() == 1) {
+			source.bands[taps[0]].convertTo(tgt, -1, w[taps[0]]);
+			continue;
 		}
+		cv::addWeighted(source.bands[taps[0]], w[taps[0]],
+						source.bands[taps[1]], w[taps[1]], 0., tgt);
+		for (size_t t = 2; t < taps.size(); ++t)
+			cv::scaleAdd(source.bands[taps[t]], w[taps[t]], tgt, tgt);
 	}
 }
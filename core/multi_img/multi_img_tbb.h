@@ -44,54 +44,58 @@ private:
 	multi_img::Value max;
 };
 
-// TODO doc
-class Xyz {
+/* computes value range of each band, reduced over blocks of image rows.
+   Non-finite values are skipped, bands without finite values keep the empty
+   range [ValueMax, ValueMin]. */
+class BandRanges {
 public:
-	Xyz(multi_img_base &multi, cv::Mat_<cv::Vec3f> &xyz, multi_img::Band &band, int cie)
-		: multi(multi), xyz(xyz), band(band), cie(cie) {}
-	void operator()(const tbb::blocked_range2d<int> &r) const;
+	BandRanges(const multi_img &multi)
+		: multi(multi), ranges(multi.size(),
+		  multi_img::Range(multi_img::ValueMax, multi_img::ValueMin)) {}
+	BandRanges(BandRanges &toSplit, tbb::split)
+		: multi(toSplit.multi), ranges(toSplit.multi.size(),
+		  multi_img::Range(multi_img::ValueMax, multi_img::ValueMin)) {}
+	void operator()(const tbb::blocked_range<int> &r);
+	void join(BandRanges &toJoin);
+	const std::vector<multi_img::Range> &GetRanges() const { return ranges; }
 private:
-	multi_img_base &multi;
-	cv::Mat_<cv::Vec3f> &xyz;
-	multi_img::Band &band;
-	int cie;
+	const multi_img &multi;
+	std::vector<multi_img::Range> ranges;
 };
 
-// TODO doc
-class Bgr {
+/* histogram of all bands over range, reduced over blocks of image rows. Each
+   body has its own partial histogram, joined by adding counts. Non-finite
+   values are skipped. */
+class RangeHistogram {
 public:
-	Bgr(multi_img_base &multi, cv::Mat_<cv::Vec3f> &xyz, cv::Mat_<cv::Vec3f> &bgr, float greensum)
-		: multi(multi), xyz(xyz), bgr(bgr), greensum(greensum) {}
-	void operator()(const tbb::blocked_range2d<int> &r) const;
+	RangeHistogram(const multi_img &multi, multi_img::Range range, int bins)
+		: multi(multi), range(range), hist(bins, 0) {}
+	RangeHistogram(RangeHistogram &toSplit, tbb::split)
+		: multi(toSplit.multi), range(toSplit.range),
+		  hist(toSplit.hist.size(), 0) {}
+	void operator()(const tbb::blocked_range<int> &r);
+	void join(RangeHistogram &toJoin);
+	const std::vector<size_t> &GetHist() const { return hist; }
 private:
-	multi_img_base &multi;
-	cv::Mat_<cv::Vec3f> &xyz;
-	cv::Mat_<cv::Vec3f> &bgr;
-	float greensum;
+	const multi_img &multi;
+	multi_img::Range range;
+	std::vector<size_t> hist;
 };
 
-// TODO doc
-class Grad {
+/* spectral gradient of the logarithm in one pass: target band i is
+   max(log(source i+1), 0) - max(log(source i), 0), within region. Works on
+   blocks of target bands (rows of the range) and region rows (cols of the
+   range), the logarithm of each source row is computed once per block. */
+class LogGrad {
 public:
-	Grad(multi_img &source, multi_img &target)
-		: source(source), target(target) {}
-	void operator()(const tbb::blocked_range<size_t> &r) const;
-
-private:
-	multi_img &source;
-	multi_img &target;
-};
-
-// TODO doc
-class Log {
-public:
-	Log(multi_img &source, multi_img &target)
-		: source(source), target(target) {}
-	void operator()(const tbb::blocked_range<size_t> &r) const;
+	LogGrad(const multi_img &source, multi_img &target, const cv::Rect &region)
+		: source(source), target(target), region(region) {}
+	void operator()(const tbb::blocked_range2d<int> &r) const;
 
 private:
-	multi_img &source;
+	const multi_img &source;
 	multi_img &target;
+	cv::Rect region;
 };
 
 // TODO doc
@@ -116,50 +120,18 @@ private:
 	multi_img &target;
 };
 
-// TODO doc
-class Illumination {
-public:
-	Illumination(multi_img &source, multi_img &target, Illuminant& il, bool remove)
-		: source(source), target(target), il(il), remove(remove) {}
-	void operator()(const tbb::blocked_range<size_t> &r) const;
-private:
-	multi_img &source;
-	multi_img &target;
-	Illuminant &il;
-	bool remove;
-};
-
-class PcaProjection {
+/* computes target bands as weighted sums of source bands, weights are
+   given as (#target x #source) matrix, see multi_img::spec_rescale_weights */
+class BandResample {
 public:
-	PcaProjection(cv::Mat_<multi_img::Value> &source, multi_img &target, cv::PCA &pca)
-		: source(source), target(target), pca(pca) {}
+	BandResample(const multi_img &source, multi_img &target,
+				 const cv::Mat1f &weights)
+		: source(source), target(target), weights(weights) {}
 	void operator()(const tbb::blocked_range<size_t> &r) const;
 private:
-	cv::Mat_<multi_img::Value> &source;
-	multi_img &target;
-	cv::PCA &pca;
-};
-
-
-class MultiImg2BandMat {
-public:
-	MultiImg2BandMat(multi_img &source, cv::Mat_<multi_img::Value> &target)
-		: source(source), target(target) {}
-	void operator()(const tbb::blocked_range<size_t> &r) const;
-private:
-	multi_img &source;
-	cv::Mat_<multi_img::Value> &target;
-};
-
-class Resize {
-public:
-	Resize(multi_img &source, multi_img &target, size_t newsize)
-		: source(source), target(target), newsize(newsize) {}
-	void operator()(const tbb::blocked_range2d<int> &r) const;
-private:
-	multi_img &source;
+	const multi_img &source;
 	multi_img &target;
-	size_t newsize;
+	const cv::Mat1f &weights;
 };
 
 #endif // MULTI_IMG_TBB_H
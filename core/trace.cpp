@@ -0,0 +1,149 @@
+#include "trace.h"
+
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/mutex.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+std::atomic<bool> Trace::active(false);
+
+namespace {
+
+struct Event {
+	const char *name, *category;
+	double begin, duration;
+};
+
+/* each thread records into its own buffer, no locking on record() */
+struct ThreadEvents {
+	ThreadEvents() : tid(++threadCount) {}
+	int tid;
+	std::vector<Event> events;
+
+	static std::atomic<int> threadCount;
+};
+std::atomic<int> ThreadEvents::threadCount(0);
+
+typedef std::chrono::steady_clock Clock;
+
+tbb::enumerable_thread_specific<ThreadEvents> buffers;
+Clock::time_point epoch = Clock::now();
+std::string outputFile;
+tbb::mutex control;
+
+// JSON string, optionally from a (mangled) typeid name
+std::string quote(const char *str, bool typeName = false)
+{
+	std::string s(str ? str : "");
+#ifdef __GNUG__
+	if (typeName) {
+		int status = -1;
+		char *demangled = abi::__cxa_demangle(s.c_str(), NULL, NULL, &status);
+		if (status == 0 && demangled)
+			s = demangled;
+		std::free(demangled);
+	}
+#endif
+	std::string ret("\"");
+	for (size_t i = 0; i < s.size(); ++i) {
+		if (s[i] == '"' || s[i] == '\\')
+			ret += '\\';
+		if ((unsigned char)s[i] >= 0x20)
+			ret += s[i];
+	}
+	return ret + "\"";
+}
+
+}
+
+void Trace::start(const std::string &file)
+{
+	tbb::mutex::scoped_lock lock(control);
+	active = false;
+	for (tbb::enumerable_thread_specific<ThreadEvents>::iterator it =
+		 buffers.begin(); it != buffers.end(); ++it)
+		it->events.clear();
+	outputFile = file;
+	epoch = Clock::now();
+	active = true;
+}
+
+void Trace::stop()
+{
+	active = false;
+}
+
+bool Trace::startFromEnvironment()
+{
+	const char *file = std::getenv("GERBIL_TRACE");
+	if (!file || !*file)
+		return false;
+	start(file);
+	return true;
+}
+
+void Trace::stopAndWrite()
+{
+	stop();
+	tbb::mutex::scoped_lock lock(control);
+	std::string file = outputFile;
+	lock.release();
+	if (!file.empty() && !write(file))
+		std::cerr << "Trace: could not write " << file << std::endl;
+}
+
+double Trace::now()
+{
+	return std::chrono::duration<double, std::micro>(
+				Clock::now() - epoch).count();
+}
+
+void Trace::record(const char *name, const char *category,
+				   double begin, double duration)
+{
+	Event e = { name, category, begin, duration };
+	buffers.local().events.push_back(e);
+}
+
+/* events must not be recorded concurrently, i.e. tracing is stopped or all
+   traced work is finished */
+void Trace::write(std::ostream &out)
+{
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	bool first = true;
+	for (tbb::enumerable_thread_specific<ThreadEvents>::const_iterator it =
+		 buffers.begin(); it != buffers.end(); ++it) {
+		out << (first ? "" : ",")
+			<< "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+			<< "\"tid\": " << it->tid << ", \"args\": {\"name\": \"thread "
+			<< it->tid << "\"}}";
+		first = false;
+		for (size_t i = 0; i < it->events.size(); ++i) {
+			const Event &e = it->events[i];
+			// background tasks are named by their type
+			bool typeName = (std::strcmp(e.category, "task") == 0);
+			out << ",\n{\"name\": " << quote(e.name, typeName)
+				<< ", \"cat\": " << quote(e.category)
+				<< ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << it->tid
+				<< ", \"ts\": " << std::fixed << e.begin
+				<< ", \"dur\": " << e.duration << "}";
+		}
+	}
+	out << "\n]}" << std::endl;
+}
+
+bool Trace::write(const std::string &file)
+{
+	std::ofstream out(file.c_str());
+	if (!out.good())
+		return false;
+	write(out);
+	return out.good();
+}
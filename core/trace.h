@@ -0,0 +1,90 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <string>
+#include <iostream>
+
+/** Lightweight tracing of timed spans, exported as Chrome trace JSON.
+
+Spans record their name, category, thread and duration. The output follows
+the Trace Event Format and can be loaded in chrome://tracing or Perfetto.
+Tracing is switched at runtime; while disabled, a span costs one atomic load.
+Usage example:
+\code
+	Trace::start();
+	{
+		TRACE_SPAN("My awesome algorithm", "algo");
+
+		// my awesome algorithm here
+	} // span ends here
+	Trace::write("trace.json");
+\endcode
+If the environment variable GERBIL_TRACE is set, the shell and the GUI start
+tracing on startup and write to the given file on exit.
+
+@note Names and categories are not copied. They need to stay valid until the
+	  trace is written, e.g. string literals or typeid names.
+**/
+class Trace {
+public:
+	/// true if spans are recorded
+	static bool enabled()
+	{ return active.load(std::memory_order_relaxed); }
+
+	/** Start recording, previous events are discarded.
+		@arg file file to write on stopAndWrite() (may be empty) */
+	static void start(const std::string &file = std::string());
+
+	/// stop recording, recorded events are kept
+	static void stop();
+
+	/** Start recording if GERBIL_TRACE is set in the environment.
+		@return true if tracing was started */
+	static bool startFromEnvironment();
+
+	/// stop recording and write to the file given on start, if any
+	static void stopAndWrite();
+
+	/// write recorded events as JSON
+	static void write(std::ostream &out);
+	/// write recorded events as JSON file
+	static bool write(const std::string &file);
+
+	/// record a complete event (times in microseconds since start)
+	static void record(const char *name, const char *category,
+					   double begin, double duration);
+
+	/// microseconds since start of recording
+	static double now();
+
+private:
+	static std::atomic<bool> active;
+};
+
+/** Span that is recorded from construction to destruction. */
+struct TraceSpan {
+	TraceSpan(const char *name, const char *category = "default")
+		: name(name), category(category), begin(-1.)
+	{
+		if (Trace::enabled())
+			begin = Trace::now();
+	}
+
+	~TraceSpan()
+	{
+		if (begin >= 0. && Trace::enabled())
+			Trace::record(name, category, begin, Trace::now() - begin);
+	}
+
+	const char *name, *category;
+	double begin;
+};
+
+#define TRACE_CONCAT_(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+/// trace the enclosing scope
+#define TRACE_SPAN(name, category) \
+	TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, category)
+
+#endif // TRACE_H
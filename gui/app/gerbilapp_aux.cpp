@@ -254,7 +254,9 @@ bool GerbilApplication::determine_limited(const
 											<< (int)hi_gpu << "</b> MB"
 					"</ul>"
 					"Please choose between speed and space optimization or close "
-					"the program in case of insufficient system ressources.";
+					"the program in case of insufficient system ressources. "
+					"Compact storage keeps the speed optimization, but holds "
+					"the input image at half precision (16 bit).";
 
 			QMessageBox msgBox;
 			msgBox.setText(text.str().c_str());
@@ -263,12 +265,18 @@ bool GerbilApplication::determine_limited(const
 			                                      QMessageBox::AcceptRole);
 			QPushButton *memory = msgBox.addButton("Memory optimization",
 			                                       QMessageBox::AcceptRole);
+			QPushButton *compact = msgBox.addButton("Compact storage",
+			                                        QMessageBox::AcceptRole);
 			QPushButton *close = msgBox.addButton("Close",
 			                                      QMessageBox::RejectRole);
 			msgBox.setDefaultButton(speed);
 			msgBox.exec();
 			if (msgBox.clickedButton() == memory)
 				return true;
+			if (msgBox.clickedButton() == compact) {
+				compactStorage = true;
+				return false;
+			}
 			if (msgBox.clickedButton() == close) {
 				quit();
 				throw shutdown_exception();
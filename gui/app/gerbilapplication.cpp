@@ -2,6 +2,7 @@
 #include "gerbilapplication.h"
 #include <dialogs/openrecent/openrecent.h>
 #include <multi_img.h>
+#include <trace.h>
 #include <controller/controller.h>
 #include <widgets/mainwindow.h>
 
@@ -26,12 +27,16 @@ int main(int argc, char **argv)
 	 */
 	tbb::task_scheduler_init tsi; // for debugging pass 1 -> only one thread
 
-	return GerbilApplication(argc, argv).exec();
+	Trace::startFromEnvironment();
+	int ret = GerbilApplication(argc, argv).exec();
+	Trace::stopAndWrite();
+	return ret;
 }
 
 GerbilApplication::GerbilApplication(int &argc, char **argv)
     : QApplication(argc, argv),
       limitedMode(false),
+      compactStorage(false),
       ctrl(nullptr)
 {
 	// set variables for QSettings use in application
@@ -36,6 +36,9 @@ public:
 	 */
 	QString imagePath();
 
+	/** True if the full image should be held in 16 bit band storage. */
+	bool isCompactStorage() const { return compactStorage; }
+
 	/** Catches exceptions thrown in Qt event handlers (so, all of them?) */
 	bool notify(QObject *receiver, QEvent *event) override;
 
@@ -111,6 +114,9 @@ protected:
 	/** True if multi-spectral image should be loaded using limited mode. */
 	bool limitedMode;
 
+	/** True if the full image should be kept in compact (16 bit) storage. */
+	bool compactStorage;
+
 	/** The input filename of the multi-spectral image. */
 	QString imageFilename;
 
@@ -5,6 +5,7 @@
 #include <rectangles.h>
 
 #include "model/imagemodel.h"
+#include "model/memoryaccountant.h"
 #include "model/labelingmodel.h"
 #include "model/illuminationmodel.h"
 #include "model/falsecolormodel.h"
@@ -14,6 +15,8 @@
 #include "widgets/mainwindow.h"
 #include "app/gerbilapplication.h" // to connect queue exception signal
 
+#include <QSettings>
+
 #include <algorithm>
 
 //#define GGDBG_MODULE
@@ -26,7 +29,7 @@ Controller::Controller(const QString &filename,
 
     : QObject(parent),
       // initialize all pointers so we don't access them too early w/o notice
-      im(nullptr), lm(nullptr), fm(nullptr), illumm(nullptr),
+      memory(nullptr), im(nullptr), lm(nullptr), fm(nullptr), illumm(nullptr),
       gsm(nullptr),
 #ifdef WITH_SEG_MEANSHIFT
       cm(nullptr),
@@ -44,7 +47,12 @@ Controller::Controller(const QString &filename,
 	        Qt::BlockingQueuedConnection);
 	startQueue();
 
-	im = new ImageModel(queue, limited_mode, this);
+	// memory budget in MiB, 0 means unlimited
+	memory = new MemoryAccountant(this);
+	memory->setBudget(QSettings().value("memory/budget", 0).toLongLong()
+	                  * 1024 * 1024);
+
+	im = new ImageModel(queue, limited_mode, memory, this);
 	// load image
 	cv::Rect dimensions = im->loadImage(filename);
 	imgSize = cv::Size(dimensions.width, dimensions.height);
@@ -53,9 +61,15 @@ Controller::Controller(const QString &filename,
 	window = new MainWindow();
 	window->initUI(filename);
 
+	connect(memory, SIGNAL(usageChanged(qint64,qint64)),
+	        window, SLOT(updateMemoryUsage(qint64,qint64)));
+	connect(window, SIGNAL(memoryBudgetRequested(qint64)),
+	        this, SLOT(setMemoryBudget(qint64)));
+	window->updateMemoryUsage(memory->getUsage(), memory->getBudget());
+
 	// initialize models
 	initImage();
-	fm = new FalseColorModel(&queue);
+	fm = new FalseColorModel(&queue, memory);
 	initFalseColor(); // depends on ImageModel / initImage()
 
 	// The order of connection is crucial for fm and Controller.
@@ -65,6 +79,8 @@ Controller::Controller(const QString &filename,
 	        fm, SLOT(processImageUpdate(representation::t,SharedMultiImgPtr,bool)));
 	connect(im, SIGNAL(imageUpdate(representation::t,SharedMultiImgPtr,bool)),
 	        this, SLOT(processImageUpdate(representation::t,SharedMultiImgPtr,bool)));
+	connect(im, SIGNAL(representationEvicted(representation::t)),
+	        this, SLOT(processRepresentationEvicted(representation::t)));
 
 	lm = new LabelingModel(this);
 	initLabeling(dimensions);
@@ -361,6 +377,8 @@ void Controller::recalcFalseColor(FalseColoring::Type coloringType)
 void Controller::subscribeRepresentation(QObject *subscriber,
                                          representation::t repr)
 {
+	// representation in use must not be evicted
+	im->setPinned(repr, true);
 	if (subscriptions.images.subscribe(subscriber, repr)) {
 		GGDBGM("new subscription, ");
 		if (roiSpawned[repr]) {
@@ -379,6 +397,20 @@ void Controller::unsubscribeRepresentation(QObject *subscriber,
 {
 	GGDBGM("unsubscribe " << repr << endl);
 	subscriptions.images.unsubscribe(subscriber, repr);
+	if (!subscriptions.images.subscribed(repr))
+		im->setPinned(repr, false);
+}
+
+void Controller::processRepresentationEvicted(representation::t repr)
+{
+	GGDBGM("evicted " << repr << endl);
+	roiSpawned[repr] = false;
+}
+
+void Controller::setMemoryBudget(qint64 budget)
+{
+	QSettings().setValue("memory/budget", budget / (1024 * 1024));
+	memory->setBudget(budget);
 }
 
 void Controller::startQueue()
@@ -23,6 +23,7 @@ class ClusteringModel;
 #endif
 class IllumModel;
 class ImageModel;
+class MemoryAccountant;
 class MainWindow;
 
 class BandDock;
@@ -154,6 +155,12 @@ protected slots:
 	                        SharedMultiImgPtr image,
 	                        bool duplicate);
 
+	// representation data was freed, spawn again on next subscription
+	void processRepresentationEvicted(representation::t repr);
+
+	// set memory budget in bytes (0: unlimited) and store it in settings
+	void setMemoryBudget(qint64 budget);
+
 /// SUBSCRIPTIONS
 
 	// Subscriptions provide a way for GUI objects to tell the Controller
@@ -283,6 +290,9 @@ protected:
 
 /// MODELS
 
+	// memory accountant keeps models within the memory budget
+	MemoryAccountant *memory;
+
 	// image model stores all multispectral image representations (IMG, GRAD,
 	// ...)
 	ImageModel *im;
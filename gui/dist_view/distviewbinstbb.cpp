@@ -2,6 +2,7 @@
 
 #include <background_task/background_task.h>
 #include <multi_img.h>
+#include <trace.h>
 
 #include <algorithm>
 #include <tbb/partitioner.h>
@@ -15,22 +16,18 @@
 class Accumulate {
 public:
 	Accumulate(bool subtract, multi_img &multi, const cv::Mat1s &labels, const cv::Mat1b &mask,
-		int nbins, multi_img::Value binsize, multi_img::Value minval, bool ignoreLabels,
-		std::vector<multi_img::Value> &illuminant,
+		const BinIndexCube &cube, bool ignoreLabels,
 		std::vector<BinSet> &sets)
-		: subtract(subtract), multi(multi), labels(labels), mask(mask), nbins(nbins), binsize(binsize),
-		minval(minval), illuminant(illuminant), ignoreLabels(ignoreLabels), sets(sets) {}
+		: subtract(subtract), multi(multi), labels(labels), mask(mask),
+		cube(cube), ignoreLabels(ignoreLabels), sets(sets) {}
 	void operator()(const tbb::blocked_range2d<int> &r) const;
 private:
 	bool subtract;
 	multi_img &multi;
 	const cv::Mat1s &labels;
 	const cv::Mat1b &mask;
-	int nbins;
-	multi_img::Value binsize;
-	multi_img::Value minval;
+	const BinIndexCube &cube;
 	bool ignoreLabels;
-	std::vector<multi_img::Value> &illuminant;
 	std::vector<BinSet> &sets;
 };
 
@@ -80,12 +77,25 @@ bool DistviewBinsTbb::run()
 	if (!keepOldContext)
 		updateContext();
 
+	/* quantize all pixels once per image and binning configuration. We are
+	 * the only thread to replace the cube, so no lock is needed for reading */
+	if (!(*cube)->matches(**multi, args, illuminant)) {
+		BinIndexCube *quantized =
+				Compute::quantizeBins(**multi, args, illuminant, stopper);
+		if (!quantized) {
+			if (!inplace)
+				delete result;
+			return false;
+		}
+		SharedDataSwapLock cube_wlock(cube->mutex);
+		cube->replace(quantized);
+	}
+
 	std::vector<cv::Rect>::iterator it;
 	/* substract pixels from bins */
 	for (it = sub.begin(); it != sub.end(); ++it) {
-		Accumulate substract(true, **multi, labels, mask, args.nbins,
-							 args.binsize, args.minval, args.ignoreLabels,
-							 illuminant, *result);
+		Accumulate substract(true, **multi, labels, mask, **cube,
+							 args.ignoreLabels, *result);
 		tbb::parallel_for(
 			tbb::blocked_range2d<int>(it->y, it->y + it->height,
 									  it->x, it->x + it->width),
@@ -93,9 +103,8 @@ bool DistviewBinsTbb::run()
 	}
 	/* add pixels to bins */
 	for (it = add.begin(); it != add.end(); ++it) {
-		Accumulate add(
-			false, **multi, labels, mask, args.nbins, args.binsize,
-					args.minval, args.ignoreLabels, illuminant, *result);
+		Accumulate add(false, **multi, labels, mask, **cube,
+					   args.ignoreLabels, *result);
 		tbb::parallel_for(
 			tbb::blocked_range2d<int>(it->y, it->y + it->height,
 									  it->x, it->x + it->width),
@@ -145,6 +154,7 @@ void DistviewBinsTbb::updateContext()
 
 void Accumulate::operator()(const tbb::blocked_range2d<int> &r) const
 {
+	TRACE_SPAN("Accumulate", "tbb");
 	for (int y = r.rows().begin(); y != r.rows().end(); ++y) {
 		const short *lr = labels[y];
 		const uchar *mr = (mask.empty() ? 0 : mask[y]);
@@ -157,13 +167,8 @@ void Accumulate::operator()(const tbb::blocked_range2d<int> &r) const
 			const multi_img::Pixel& pixel = multi(y, x);
 			BinSet &s = sets[label];
 
-			BinSet::HashKey hashkey(multi.size());
-            for (unsigned int d = 0; d < multi.size(); ++d) {
-				int pos = floor(Compute::curpos(
-									pixel[d], d, minval, binsize, illuminant));
-				pos = std::max(pos, 0); pos = std::min(pos, nbins-1);
-				hashkey[d] = (unsigned char)pos;
-			}
+			const unsigned char *bins = cube(y, x);
+			BinSet::HashKey hashkey(bins, bins + cube.dimensionality);
 
 			if (subtract) {
 				BinSet::HashMap::accessor ac;
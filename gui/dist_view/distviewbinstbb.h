@@ -20,7 +20,7 @@ public:
 		const QVector<QColor> &colors,
 		const std::vector<multi_img::Value> &illuminant,
 		const ViewportCtx &args, vpctx_ptr context,
-		sets_ptr current,
+		sets_ptr current, cube_ptr cube,
 		sets_ptr temp = sets_ptr(new SharedData<std::vector<BinSet> >(NULL)),
 		const std::vector<cv::Rect> &sub = std::vector<cv::Rect>(),
 		const std::vector<cv::Rect> &add = std::vector<cv::Rect>(),
@@ -28,7 +28,7 @@ public:
 		bool inplace = false, bool apply = true)
 		: BackgroundTask(), multi(multi), labels(labels), colors(colors),
 		illuminant(illuminant), args(args), context(context),
-		current(current), temp(temp), sub(sub), add(add), mask(mask), inplace(inplace), apply(apply) {}
+		current(current), cube(cube), temp(temp), sub(sub), add(add), mask(mask), inplace(inplace), apply(apply) {}
 	virtual ~DistviewBinsTbb() {}
 	virtual bool run();
 	// helper to run(): update viewport context
@@ -49,6 +49,8 @@ protected:
 	// target context
 	vpctx_ptr context;
 	sets_ptr current;
+	// bin indices of multi, recomputed if outdated
+	cube_ptr cube;
 	sets_ptr temp;
 
 	std::vector<cv::Rect> sub;
@@ -5,8 +5,11 @@
 //#define GGDBG_MODULE
 #include "../gerbil_gui_debug.h"
 
+#include <trace.h>
+
 #include <QGLBuffer>
 #include <algorithm>
+#include <cmath>
 
 // altmann, debugging helper function
 bool assertBinSetsKeyDim(const std::vector<BinSet> &v, const ViewportCtx &ctx) {
@@ -76,23 +79,144 @@ multi_img::Value Compute::curpos(
 	return curpos;
 }
 
+bool BinIndexCube::matches(const multi_img_base &image,
+						   const ViewportCtx &ctx,
+						   const std::vector<multi_img::Value> &illum) const
+{
+	return !data.empty() && data.rows == image.height
+			&& data.cols == image.width * (int)image.size()
+			&& dimensionality == image.size()
+			&& nbins == ctx.nbins && minval == ctx.minval
+			&& binsize == ctx.binsize && illuminant == illum;
+}
+
+/* fills rows of the bin index cube, band by band */
+class QuantizeBins {
+public:
+	QuantizeBins(const multi_img &image, BinIndexCube &cube)
+		: image(image), cube(cube) {}
+
+	void operator()(const tbb::blocked_range<int> &r) const
+	{
+		TRACE_SPAN("QuantizeBins", "tbb");
+		const size_t dim = cube.dimensionality;
+		for (size_t d = 0; d < dim; ++d) {
+			const multi_img::Band &band = image[d];
+			for (int y = r.begin(); y != r.end(); ++y) {
+				const multi_img::Value *brow = band[y];
+				unsigned char *crow = cube.data[y] + d;
+				for (int x = 0; x < image.width; ++x, crow += dim) {
+					int pos = std::floor(Compute::curpos(brow[x], d,
+						cube.minval, cube.binsize, cube.illuminant));
+					pos = std::max(pos, 0); pos = std::min(pos, cube.nbins-1);
+					*crow = (unsigned char)pos;
+				}
+			}
+		}
+	}
+
+private:
+	const multi_img &image;
+	BinIndexCube &cube;
+};
+
+BinIndexCube* Compute::quantizeBins(const multi_img &image,
+									const ViewportCtx &ctx,
+									const std::vector<multi_img::Value> &illum,
+									tbb::task_group_context &stopper)
+{
+	BinIndexCube *cube = new BinIndexCube();
+	cube->dimensionality = image.size();
+	cube->nbins = ctx.nbins;
+	cube->minval = ctx.minval;
+	cube->binsize = ctx.binsize;
+	cube->illuminant = illum;
+	cube->data.create(image.height, image.width * (int)image.size());
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, image.height),
+		QuantizeBins(image, *cube), tbb::auto_partitioner(), stopper);
+	if (stopper.is_group_execution_cancelled()) {
+		delete cube;
+		return NULL;
+	}
+	return cube;
+}
+
+void BinColorCache::begin(const ViewportCtx &ctx, size_t nsets)
+{
+	if (!transform.matches(ctx.meta, ctx.maxval)) {
+		transform = ColorTransform(ctx.meta, ctx.maxval);
+		previous.clear();
+	}
+	previous.resize(nsets);
+	current.clear();
+	current.resize(nsets);
+}
+
+void BinColorCache::end()
+{
+	previous.swap(current);
+	current.clear();
+}
+
+size_t BinColorCache::hash(const Bin &b)
+{
+	size_t seed = 0;
+	boost::hash_combine(seed, b.weight);
+	boost::hash_range(seed, b.means.begin(), b.means.end());
+	return seed;
+}
+
 void Compute::PreprocessBins::operator()(const BinSet::HashMap::range_type &r)
 {
-	cv::Vec3f color;
-	multi_img::Pixel pixel(dimensionality);
+	TRACE_SPAN("PreprocessBins", "tbb");
+	// bins of this range that need a fresh color, and their hashes
+	std::vector<std::pair<BinSet::HashMap::iterator, size_t> > uncolored;
+
+	BinColorCache::Map &previous = colors.previous[label];
+	BinColorCache::Map &current = colors.current[label];
 	BinSet::HashMap::iterator it;
 	for (it = r.begin(); it != r.end(); it++) {
 		Bin &b = it->second;
 		for (size_t d = 0; d < dimensionality; ++d) {
-			pixel[d] = b.means[d] / b.weight;
 			std::pair<int, int> &range = ranges[d];
 			range.first = std::min<int>(range.first, (int)(it->first)[d]);
 			range.second = std::max<int>(range.second, (int)(it->first)[d]);
 		}
-		// TODO: calculate colors for all pixels BEFORE this step with functor
-		color = multi_img::bgr(pixel, meta, maxval);
-		b.rgb = QColor(color[2]*255, color[1]*255, color[0]*255);
 		index.push_back(make_pair(label, it->first));
+
+		size_t h = BinColorCache::hash(b);
+		BinColorCache::Map::const_accessor ac;
+		if (previous.find(ac, it->first) && ac->second.first == h) {
+			b.rgb = ac->second.second;
+			current.insert(std::make_pair(it->first, ac->second));
+		} else {
+			uncolored.push_back(std::make_pair(it, h));
+		}
+	}
+
+	if (uncolored.empty()
+		|| colors.transform.weights().rows != (int)dimensionality)
+		return;
+
+	/* calculate colors of all remaining bins in one batch */
+	cv::Mat1f means(uncolored.size(), dimensionality);
+	cv::Mat3f bgr;
+	for (size_t i = 0; i < uncolored.size(); ++i) {
+		const Bin &b = uncolored[i].first->second;
+		float *row = means[i];
+		for (size_t d = 0; d < dimensionality; ++d)
+			row[d] = b.means[d] / b.weight;
+	}
+	colors.transform.bgr(means, bgr);
+
+	for (size_t i = 0; i < uncolored.size(); ++i) {
+		BinSet::HashMap::iterator &bit = uncolored[i].first;
+		const cv::Vec3f &color = bgr(i, 0);
+		Bin &b = bit->second;
+		b.rgb = QColor(color[2]*255, color[1]*255, color[0]*255);
+		current.insert(std::make_pair(bit->first,
+		               BinColorCache::Entry(uncolored[i].second, b.rgb)));
 	}
 }
 
@@ -107,30 +231,147 @@ void Compute::PreprocessBins::join(PreprocessBins &toJoin)
 }
 
 void Compute::preparePolylines(const ViewportCtx &ctx,
-							   std::vector<BinSet> &sets, binindex &index)
+							   std::vector<BinSet> &sets, binindex &index,
+							   BinColorCache &colors, int displayHeight)
 {
 	if (!assertBinSetsKeyDim(sets, ctx)) { // 	assert(sets.size()>0);
 		return;
 	}
 
 	index.clear();
+	colors.begin(ctx, sets.size());
 	//GGDBGP("Compute::preparePolylines() sets.size() = " << sets.size() << endl);
 	for (unsigned int i = 0; i < sets.size(); ++i) {
 		BinSet &s = sets[i];
-		PreprocessBins preprocess(i, ctx.dimensionality,
-			ctx.maxval, ctx.meta, index);
+		PreprocessBins preprocess(i, ctx.dimensionality, colors, index);
 		tbb::parallel_reduce(BinSet::HashMap::range_type(s.bins),
 			preprocess, tbb::auto_partitioner());
 		s.boundary = preprocess.GetRanges();
 	}
+	colors.end();
 
 	if (index.begin() == index.end()) {
 		GGDBGP("Compute::preparePolylines(): error: empty index" << endl);
 		return;
 	}
 
-	// shuffle the index for clutter-reduction
-	std::random_shuffle(index.begin(), index.end());
+	// order the index for progressive rendering and clutter-reduction
+	orderByDetail(ctx, sets, index, displayHeight);
+}
+
+/* one index entry in level-of-detail ordering */
+struct DetailEntry {
+	// true if entry represents its coarse cell (level 0)
+	bool coarse;
+	float weight;
+	// position in original index
+	size_t pos;
+
+	// level 0 first, then heavy before light, then original order
+	bool operator<(const DetailEntry &o) const {
+		if (coarse != o.coarse)
+			return coarse;
+		if (weight != o.weight)
+			return weight > o.weight;
+		return pos < o.pos;
+	}
+};
+
+/* maps a coarse cell key to the index position of its representative */
+typedef tbb::concurrent_hash_map<BinSet::HashKey, size_t,
+								 BinSet::vector_char_hash_compare> CellMap;
+
+class DetermineCells {
+public:
+	DetermineCells(const std::vector<BinSet> &sets, const binindex &index,
+				   int factor, std::vector<DetailEntry> &entries,
+				   std::vector<CellMap> &cells)
+		: sets(sets), index(index), factor(factor), entries(entries),
+		  cells(cells) {}
+
+	void operator()(const tbb::blocked_range<size_t> &r) const
+	{
+		TRACE_SPAN("DetermineCells", "tbb");
+		for (size_t i = r.begin(); i != r.end(); ++i) {
+			const std::pair<int, BinSet::HashKey> &idx = index[i];
+			const BinSet &s = sets[idx.first];
+			const BinSet::HashKey &K = idx.second;
+
+			// read-only access, see GenerateVertices
+			BinSet::HashMap::const_iterator it = s.bins.equal_range(K).first;
+			float weight = (it == s.bins.end() ? 0.f : it->second.weight);
+			DetailEntry &e = entries[i];
+			e.coarse = false;
+			e.weight = weight;
+			e.pos = i;
+
+			BinSet::HashKey cell(K.size());
+			for (size_t d = 0; d < K.size(); ++d)
+				cell[d] = (unsigned char)(K[d] / factor);
+
+			// keep heaviest bin of cell (first position on ties)
+			CellMap::accessor acc;
+			if (cells[idx.first].insert(acc, cell)) {
+				acc->second = i;
+			} else {
+				const DetailEntry &rep = entries[acc->second];
+				if (rep.weight < weight
+					|| (rep.weight == weight && acc->second > i))
+					acc->second = i;
+			}
+		}
+	}
+
+private:
+	const std::vector<BinSet> &sets;
+	const binindex &index;
+	int factor;
+	std::vector<DetailEntry> &entries;
+	std::vector<CellMap> &cells;
+};
+
+size_t Compute::orderByDetail(const ViewportCtx &ctx,
+							  const std::vector<BinSet> &sets,
+							  binindex &index, int displayHeight)
+{
+	const size_t n = index.size();
+	if (n == 0)
+		return 0;
+
+	/* number of bins per band collapsed into one cell, such that one cell
+	 * covers about LOD_CELL_PIXELS on screen */
+	int factor = 2;
+	if (displayHeight > 0) {
+		factor = (ctx.nbins * LOD_CELL_PIXELS + displayHeight - 1)
+				/ displayHeight;
+		factor = std::max(factor, 2);
+	}
+
+	std::vector<DetailEntry> entries(n);
+	std::vector<CellMap> cells(sets.size());
+	// entries of representatives are only read after they were written, as
+	// the accessor lock serializes each cell
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, n),
+		DetermineCells(sets, index, factor, entries, cells),
+		tbb::auto_partitioner());
+
+	size_t coarse = 0;
+	for (size_t l = 0; l < cells.size(); ++l) {
+		CellMap::const_iterator it;
+		for (it = cells[l].begin(); it != cells[l].end(); ++it) {
+			entries[it->second].coarse = true;
+			++coarse;
+		}
+	}
+
+	tbb::parallel_sort(entries.begin(), entries.end());
+
+	std::vector<std::pair<int, BinSet::HashKey> > old(index.begin(),
+													   index.end());
+	for (size_t i = 0; i < n; ++i)
+		index[i].swap(old[entries[i].pos]);
+
+	return coarse;
 }
 
 void Compute::storeVertices(const ViewportCtx &ctx,
@@ -176,6 +417,7 @@ void Compute::storeVertices(const ViewportCtx &ctx,
 
 void Compute::GenerateVertices::operator()(const tbb::blocked_range<size_t> &r) const
 {
+	TRACE_SPAN("GenerateVertices", "tbb");
 	for (tbb::blocked_range<size_t>::const_iterator i = r.begin();
 		 i != r.end();
 		 ++i)
@@ -4,6 +4,7 @@
 #include "../model/representation.h"
 
 #include <multi_img.h>
+#include <multi_img/colortransform.h>
 #include <shared_data.h>
 
 #include <QGLBuffer>
@@ -18,6 +19,7 @@
 #include <tbb/partitioner.h>
 #include <tbb/parallel_for.h>
 #include <tbb/parallel_reduce.h>
+#include <tbb/parallel_sort.h>
 #include <tbb/tbb_allocator.h>
 #include <boost/functional/hash.hpp>
 
@@ -139,6 +141,58 @@ struct ViewportCtx {
 
 typedef boost::shared_ptr<SharedData<ViewportCtx> > vpctx_ptr;
 
+/* quantized bin indices of all pixels, as used in the hash keys
+ * one row per image row, dimensionality entries per pixel (interleaved)
+ * the cube is computed once per image and binning configuration. Hash keys
+ * and highlight masks are derived from it without quantizing again.
+ */
+struct BinIndexCube {
+	BinIndexCube() : dimensionality(0), nbins(0), minval(0.f), binsize(0.f) {}
+
+	/* true if the cube holds the binning of image with given configuration */
+	bool matches(const multi_img_base &image, const ViewportCtx &ctx,
+				 const std::vector<multi_img::Value> &illuminant) const;
+
+	/* bin indices of pixel (y, x) */
+	inline const unsigned char* operator()(int y, int x) const
+	{ return data[y] + x * dimensionality; }
+
+	cv::Mat1b data;
+
+	/* binning configuration the cube was computed with */
+	size_t dimensionality;
+	int nbins;
+	multi_img::Value minval;
+	multi_img::Value binsize;
+	std::vector<multi_img::Value> illuminant;
+};
+
+typedef boost::shared_ptr<SharedData<BinIndexCube> > cube_ptr;
+
+/* sRGB colors of bin means, kept across rebinning
+ * the color of a bin is reused if its key and its means did not change
+ */
+struct BinColorCache {
+	// hash of means and weight of the bin, color
+	typedef std::pair<size_t, QColor> Entry;
+	typedef tbb::concurrent_hash_map<BinSet::HashKey, Entry,
+									 BinSet::vector_char_hash_compare> Map;
+
+	/* prepare a new pass over nsets binsets, drops all colors if the band
+	 * layout changed */
+	void begin(const ViewportCtx &context, size_t nsets);
+	/* finish the pass, only colors of bins seen during the pass are kept */
+	void end();
+
+	/* hash of unnormalized means and weight of a bin */
+	static size_t hash(const Bin &b);
+
+	/* spectrum to sRGB conversion for current band layout */
+	ColorTransform transform;
+	/* per label, colors of last pass (read) and current pass (written) */
+	std::vector<Map> previous, current;
+};
+
 class Compute
 {
 public:
@@ -150,20 +204,40 @@ public:
 							  const std::vector<multi_img::Value> &illuminant
 								   = std::vector<multi_img::Value>());
 
-	/* method and helper class to preprocess bins before vertex generation */
+	/* compute bin indices of all pixels, returns NULL if cancelled */
+	static BinIndexCube* quantizeBins(const multi_img &image,
+								const ViewportCtx &context,
+								const std::vector<multi_img::Value> &illuminant,
+								tbb::task_group_context &stopper);
+
+	/* method and helper class to preprocess bins before vertex generation
+	 * displayHeight is the height of the plot in pixels, used for
+	 * level-of-detail ordering (0 if unknown) */
 	static void preparePolylines(const ViewportCtx &context,
-								 std::vector<BinSet> &sets, binindex &index);
+								 std::vector<BinSet> &sets, binindex &index,
+								 BinColorCache &colors,
+								 int displayHeight = 0);
+
+	/* level-of-detail ordering of the bin index (replaces random shuffle)
+	 * bins are grouped in coarse cells of LOD_CELL_PIXELS screen pixels per
+	 * band. The heaviest bin of each cell is emitted first (level 0), then
+	 * all remaining bins follow (level 1), both ordered by weight. This way
+	 * the first render step shows a representative subset and full detail
+	 * streams in afterwards. Returns the number of level 0 entries. */
+	static size_t orderByDetail(const ViewportCtx &context,
+								const std::vector<BinSet> &sets,
+								binindex &index, int displayHeight);
+	static const int LOD_CELL_PIXELS = 8;
 
 	class PreprocessBins {
 	public:
-		PreprocessBins(int label, size_t dimensionality, multi_img::Value maxval,
-			const std::vector<multi_img::BandDesc> &meta,
-			binindex &index)
-			: label(label), dimensionality(dimensionality), maxval(maxval), meta(meta),
+		PreprocessBins(int label, size_t dimensionality,
+			BinColorCache &colors, binindex &index)
+			: label(label), dimensionality(dimensionality), colors(colors),
 			index(index), ranges(dimensionality, std::pair<int, int>(INT_MAX, INT_MIN)) {}
 		PreprocessBins(PreprocessBins &toSplit, tbb::split)
 			: label(toSplit.label), dimensionality(toSplit.dimensionality),
-			maxval(toSplit.maxval), meta(toSplit.meta),
+			colors(toSplit.colors),
 			index(toSplit.index), ranges(dimensionality, std::pair<int, int>(INT_MAX, INT_MIN)) {}
 		void operator()(const BinSet::HashMap::range_type &r);
 		void join(PreprocessBins &toJoin);
@@ -171,8 +245,7 @@ public:
 	private:
 		int label;
 		size_t dimensionality;
-		multi_img::Value maxval;
-		const std::vector<multi_img::BandDesc> &meta;
+		BinColorCache &colors;
 		// pair of label index and hash-key within label's bin set
 		binindex &index;
 		std::vector<std::pair<int, int> > ranges;
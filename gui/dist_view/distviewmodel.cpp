@@ -21,7 +21,8 @@
 #include <gerbil_gui_debug.h>
 
 DistViewModel::DistViewModel(representation::t type)
-	: type(type), queue(NULL),
+	: type(type),
+	  cube(new SharedData<BinIndexCube>(new BinIndexCube())), queue(NULL),
 	  ignoreLabels(false),
 	  inbetween(false)
 {}
@@ -65,7 +66,8 @@ void DistViewModel::updateBinning(int bins)
 		return;
 
 	BackgroundTaskPtr taskBins(new DistviewBinsTbb(
-		image, labels, labelColors, illuminant, args, context, binsets));
+		image, labels, labelColors, illuminant, args, context, binsets,
+		cube));
 	QObject::connect(taskBins.get(), SIGNAL(finished(bool)),
 					 this, SLOT(propagateBinning(bool)), Qt::QueuedConnection);
 	queue->push(taskBins);
@@ -86,7 +88,8 @@ void DistViewModel::toggleLabels(bool toggle, bool active)
 		return;
 
 	BackgroundTaskPtr taskBins(new DistviewBinsTbb(
-		image, labels, labelColors, illuminant, args, context, binsets));
+		image, labels, labelColors, illuminant, args, context, binsets,
+		cube));
 	QObject::connect(taskBins.get(), SIGNAL(finished(bool)),
 					 this, SLOT(propagateBinning(bool)), Qt::QueuedConnection);
 	queue->push(taskBins);
@@ -109,7 +112,8 @@ void DistViewModel::updateLabels(const cv::Mat1s &newLabels, bool active)
 	args.wait.fetch_and_store(1);
 
 	BackgroundTaskPtr taskBins(new DistviewBinsTbb(
-		image, labels, labelColors, illuminant, args, context, binsets));
+		image, labels, labelColors, illuminant, args, context, binsets,
+		cube));
 	QObject::connect(taskBins.get(), SIGNAL(finished(bool)),
 					 this, SLOT(propagateBinning(bool)), Qt::QueuedConnection);
 	queue->push(taskBins);
@@ -140,7 +144,7 @@ void DistViewModel::updateLabelsPartially(const cv::Mat1s &newLabels,
 		sub.push_back(cv::Rect(0, 0, mask.cols, mask.rows));
 		BackgroundTaskPtr taskBins(new DistviewBinsTbb(
 			image, oldLabels, labelColors, illuminant, args,
-			context, binsets, temp, sub, std::vector<cv::Rect>(),
+			context, binsets, cube, temp, sub, std::vector<cv::Rect>(),
 			mask, false, false));
 		queue->push(taskBins);
 	}
@@ -153,7 +157,7 @@ void DistViewModel::updateLabelsPartially(const cv::Mat1s &newLabels,
 		add.push_back(cv::Rect(0, 0, mask.cols, mask.rows));
 		BackgroundTaskPtr taskBins(new DistviewBinsTbb(
 			image, labels, labelColors, illuminant, args,
-			context, binsets, temp, std::vector<cv::Rect>(), add,
+			context, binsets, cube, temp, std::vector<cv::Rect>(), add,
 			mask, false, true));
 
 		// final signal
@@ -184,7 +188,7 @@ sets_ptr DistViewModel::subImage(const std::vector<cv::Rect> &regions,
 
 	BackgroundTaskPtr taskBins(new DistviewBinsTbb(
 		image, labels, labelColors, illuminant, args, context, binsets,
-		temp, regions,
+		cube, temp, regions,
 		std::vector<cv::Rect>(), cv::Mat1b(), false, false));
 	queue->push(taskBins);
 
@@ -214,9 +218,12 @@ void DistViewModel::addImage(sets_ptr temp,const std::vector<cv::Rect> &regions,
 	args.reset.fetch_and_store(1);
 	args.wait.fetch_and_store(1);
 
+	// image data was replaced, pending tasks keep the previous cube
+	resetCube();
+
 	BackgroundTaskPtr taskBins(new DistviewBinsTbb(
 		image, labels, labelColors, illuminant, args, context,
-		binsets, temp, std::vector<cv::Rect>(), regions,
+		binsets, cube, temp, std::vector<cv::Rect>(), regions,
 		cv::Mat1b(), false, true));
 	// connect to propagateBinningRange as this operation can change range
 	QObject::connect(taskBins.get(), SIGNAL(finished(bool)),
@@ -229,6 +236,7 @@ void DistViewModel::setImage(SharedMultiImgPtr img, cv::Rect roi, int bins)
 	GGDBGM(type << endl);
 	inbetween = false;
 	image = img;
+	resetCube();
 	//GGDBGM(format("image.get()=%1%\n") %image.get());
 
 	SharedDataLock ctxlock(context->mutex);
@@ -248,7 +256,7 @@ void DistViewModel::setImage(SharedMultiImgPtr img, cv::Rect roi, int bins)
 	assert(context);
 	BackgroundTaskPtr taskBins(new DistviewBinsTbb(
 		image, labels, labelColors, illuminant, args, context, binsets,
-		sets_ptr(new SharedData<std::vector<BinSet> >(NULL)),
+		cube, sets_ptr(new SharedData<std::vector<BinSet> >(NULL)),
 		std::vector<cv::Rect>(), std::vector<cv::Rect>(),
 		cv::Mat1b(), false, true));
 	// connect to propagateBinningRange, new image may have new range
@@ -271,6 +279,11 @@ void DistViewModel::propagateBinningRange(bool updated)
 	emit newBinningRange(type);
 }
 
+void DistViewModel::resetCube()
+{
+	cube = cube_ptr(new SharedData<BinIndexCube>(new BinIndexCube()));
+}
+
 /*********   H I G H L I G H T   M A S K   **********/
 
 void DistViewModel::clearMask()
@@ -279,13 +292,25 @@ void DistViewModel::clearMask()
 	highlightMask = cv::Mat1b((*image)->height, (*image)->width, (uchar)0);
 }
 
+/* masks are derived from the bin index cube. While it is outdated (binning
+ * in progress), the mask stays empty. Callers hold all locks. */
+bool DistViewModel::cubeCurrent()
+{
+	if ((*cube)->matches(**image, **context, illuminant))
+		return true;
+	highlightMask.setTo(0);
+	return false;
+}
+
 /* create mask from single-band user selection */
 void DistViewModel::fillMaskSingle(int dim, int sel)
 {
 	SharedDataLock imagelock(image->mutex);
 	SharedDataLock ctxlock(context->mutex);
-	fillMaskSingleBody body(highlightMask, (**image)[dim], dim, sel,
-		(*context)->minval, (*context)->binsize, illuminant);
+	SharedDataLock cubelock(cube->mutex);
+	if (!cubeCurrent())
+		return;
+	fillMaskSingleBody body(highlightMask, **cube, dim, sel);
 	tbb::parallel_for(tbb::blocked_range2d<size_t>(
 		0, highlightMask.rows, 0, highlightMask.cols), body);
 }
@@ -295,8 +320,10 @@ void DistViewModel::fillMaskLimiters(const std::vector<std::pair<int, int> >& l)
 {
 	SharedDataLock imagelock(image->mutex);
 	SharedDataLock ctxlock(context->mutex);
-	fillMaskLimitersBody body(highlightMask, **image, (*context)->minval,
-		(*context)->binsize, illuminant, l);
+	SharedDataLock cubelock(cube->mutex);
+	if (!cubeCurrent())
+		return;
+	fillMaskLimitersBody body(highlightMask, **cube, l);
 	tbb::parallel_for(tbb::blocked_range2d<size_t>(
 		0,(*image)->height, 0, (*image)->width), body);
 }
@@ -307,8 +334,10 @@ void DistViewModel::updateMaskLimiters(
 {
 	SharedDataLock imagelock(image->mutex);
 	SharedDataLock ctxlock(context->mutex);
-	updateMaskLimitersBody body(highlightMask, **image, dim, (*context)->minval,
-		(*context)->binsize, illuminant, l);
+	SharedDataLock cubelock(cube->mutex);
+	if (!cubeCurrent())
+		return;
+	updateMaskLimitersBody body(highlightMask, **cube, dim, l);
 	tbb::parallel_for(tbb::blocked_range2d<size_t>(
 		0,(*image)->height, 0, (*image)->width), body);
 }
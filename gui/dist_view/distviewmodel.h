@@ -66,12 +66,18 @@ signals:
 	void newBinningRange(representation::t type);
 
 protected:
+	// start a new bin index cube for new image data
+	void resetCube();
+	// check if cube fits image and context, clear mask otherwise
+	bool cubeCurrent();
 
 	representation::t type;
 	SharedMultiImgPtr image;
 	cv::Mat1s labels;
 	vpctx_ptr context;
 	sets_ptr binsets;
+	// quantized bin indices of image, computed by binning task
+	cube_ptr cube;
 	BackgroundTaskQueue *queue;
 
 	QVector<QColor> labelColors;
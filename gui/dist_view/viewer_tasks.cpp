@@ -5,32 +5,37 @@
 #include <tbb/blocked_range2d.h>
 #include <tbb/task.h>
 
+/* true if all bin indices lie within the limiters */
+static inline bool withinLimiters(const unsigned char *bins, size_t dim,
+								  const std::vector<std::pair<int, int> > &l)
+{
+	for (size_t d = 0; d < dim; ++d) {
+		if (bins[d] < l[d].first || bins[d] > l[d].second)
+			return false;
+	}
+	return true;
+}
+
 ///////////////////////////////
 /// fillMaskSingleBody
 ///////////////////////////////
 
 fillMaskSingleBody::fillMaskSingleBody(
-		cv::Mat1b &mask, const
-		multi_img::Band &band, int dim, int sel,
-		multi_img::Value minval,
-		multi_img::Value binsize,
-		const std::vector<multi_img::Value>
-		&illuminant)
-	: mask(mask), band(band), dim(dim), sel(sel), minval(minval),
-	  binsize(binsize), illuminant(illuminant)
+		cv::Mat1b &mask, const BinIndexCube &cube, int dim, int sel)
+	: mask(mask), cube(cube), dim(dim), sel(sel)
 {
 }
 
 void fillMaskSingleBody::operator ()(
 		const tbb::blocked_range2d<size_t> &r) const
 {
+	const size_t stride = cube.dimensionality;
 	for (size_t y = r.rows().begin(); y != r.rows().end(); ++y) {
 		unsigned char *mrow = mask[y];
-		const multi_img::Value *brow = band[y];
-		for (size_t x = r.cols().begin(); x != r.cols().end(); ++x) {
-			int pos = floor(
-					Compute::curpos(brow[x], dim, minval, binsize, illuminant));
-			mrow[x] = (pos == sel) ? 1 : 0;
+		const unsigned char *crow = cube(y, r.cols().begin()) + dim;
+		for (size_t x = r.cols().begin(); x != r.cols().end();
+			 ++x, crow += stride) {
+			mrow[x] = (*crow == sel) ? 1 : 0;
 		}
 	}
 }
@@ -40,11 +45,9 @@ void fillMaskSingleBody::operator ()(
 ///////////////////////////////
 
 fillMaskLimitersBody::fillMaskLimitersBody(
-		cv::Mat1b &mask, const multi_img &image, multi_img::Value
-		minval, multi_img::Value binsize, const std::vector<multi_img::Value>
-		&illuminant, const std::vector<std::pair<int, int> > &l)
-	: mask(mask), image(image), minval(minval), binsize(binsize),
-	illuminant(illuminant), l(l)
+		cv::Mat1b &mask, const BinIndexCube &cube,
+		const std::vector<std::pair<int, int> > &l)
+	: mask(mask), cube(cube), l(l)
 {
 }
 
@@ -54,16 +57,7 @@ void fillMaskLimitersBody::operator ()(
 	for (size_t y = r.rows().begin(); y != r.rows().end(); ++y) {
 		unsigned char *row = mask[y];
 		for (size_t x = r.cols().begin(); x != r.cols().end(); ++x) {
-			row[x] = 1;
-			const multi_img::Pixel &p = image(y, x);
-			for (unsigned int d = 0; d < image.size(); ++d) {
-				int pos = floor(Compute::curpos(
-									p[d], d, minval, binsize, illuminant));
-				if (pos < l[d].first || pos > l[d].second) {
-					row[x] = 0;
-					break;
-				}
-			}
+			row[x] = withinLimiters(cube(y, x), cube.dimensionality, l);
 		}
 	}
 }
@@ -73,12 +67,9 @@ void fillMaskLimitersBody::operator ()(
 ///////////////////////////////
 
 updateMaskLimitersBody::updateMaskLimitersBody(
-		cv::Mat1b &mask, const multi_img &image, int dim,
-		multi_img::Value minval, multi_img::Value binsize, 
-		const std::vector<multi_img::Value> &illuminant, 
+		cv::Mat1b &mask, const BinIndexCube &cube, int dim,
 		const std::vector<std::pair<int, int> > &l)
-	: mask(mask), image(image), dim(dim), minval(minval),
-	binsize(binsize), illuminant(illuminant), l(l)
+	: mask(mask), cube(cube), dim(dim), l(l)
 {
 }
 
@@ -87,23 +78,12 @@ void updateMaskLimitersBody::operator ()(
 {
 	for (size_t y = r.rows().begin(); y != r.rows().end(); ++y) {
 		unsigned char *mrow = mask[y];
-		const multi_img::Value *brow = image[dim][y];
 		for (size_t x = r.cols().begin(); x != r.cols().end(); ++x) {
-			int pos = floor(Compute::curpos(
-								brow[x], dim, minval, binsize, illuminant));
-			if (pos < l[dim].first || pos > l[dim].second) {
+			const unsigned char *bins = cube(y, x);
+			if (bins[dim] < l[dim].first || bins[dim] > l[dim].second) {
 				mrow[x] = 0;
 			} else if (mrow[x] == 0) { // we need to do exhaustive test
-				mrow[x] = 1;
-				const multi_img::Pixel& p = image(y, x);
-				for (unsigned int d = 0; d < image.size(); ++d) {
-					int pos = floor(Compute::curpos(
-										p[d], d, minval, binsize, illuminant));
-					if (pos < l[d].first || pos > l[d].second) {
-						mrow[x] = 0;
-						break;
-					}
-				}
+				mrow[x] = withinLimiters(bins, cube.dimensionality, l);
 			}
 		}
 	}
@@ -11,33 +11,25 @@
 #include <tbb/partitioner.h>
 #include <tbb/parallel_for.h>
 
+/* mask bodies compare precomputed bin indices, see BinIndexCube */
 struct fillMaskSingleBody {
 	cv::Mat1b &mask;
-	const multi_img::Band &band;
+	const BinIndexCube &cube;
 	int dim;
 	int sel;
-	multi_img::Value minval;
-	multi_img::Value binsize;
-	const std::vector<multi_img::Value> &illuminant;
 
-	fillMaskSingleBody(cv::Mat1b &mask, const multi_img::Band &band, int
-			dim, int sel, multi_img::Value minval, multi_img::Value binsize,
-			const std::vector<multi_img::Value> &illuminant);
+	fillMaskSingleBody(cv::Mat1b &mask, const BinIndexCube &cube,
+			int dim, int sel);
 
 	void operator()(const tbb::blocked_range2d<size_t> &r) const;
 };
 
 struct fillMaskLimitersBody {
 	cv::Mat1b &mask;
-	const multi_img &image;
-	multi_img::Value minval;
-	multi_img::Value binsize;
-	const std::vector<multi_img::Value> &illuminant;
+	const BinIndexCube &cube;
 	const std::vector<std::pair<int, int> > &l;
 
-	fillMaskLimitersBody(cv::Mat1b &mask, const multi_img &image,
-		multi_img::Value minval, multi_img::Value binsize,
-		const std::vector<multi_img::Value> &illuminant,
+	fillMaskLimitersBody(cv::Mat1b &mask, const BinIndexCube &cube,
 		const std::vector<std::pair<int, int> > &l);
 
 	void operator()(const tbb::blocked_range2d<size_t> &r) const;
@@ -45,16 +37,11 @@ struct fillMaskLimitersBody {
 
 struct updateMaskLimitersBody {
 	cv::Mat1b &mask;
-	const multi_img &image;
+	const BinIndexCube &cube;
 	int dim;
-	multi_img::Value minval;
-	multi_img::Value binsize;
-	const std::vector<multi_img::Value> &illuminant;
 	const std::vector<std::pair<int, int> > &l;
 
-	updateMaskLimitersBody(cv::Mat1b &mask, const multi_img &image, int dim,
-		multi_img::Value minval, multi_img::Value binsize,
-		const std::vector<multi_img::Value> &illuminant,
+	updateMaskLimitersBody(cv::Mat1b &mask, const BinIndexCube &cube, int dim,
 		const std::vector<std::pair<int, int> > &l);
 
 
@@ -15,6 +15,7 @@
 
 #include <qtopencv.h>
 #include <stopwatch.h>
+#include <trace.h>
 
 #include <iostream>
 #include <QApplication>
@@ -40,7 +41,7 @@ Viewport::Viewport(representation::t type, QGLWidget *target)
       zoom(1.), holdSelection(false), activeLimiter(0),
       drawLog(nullptr), drawMeans(nullptr), drawRGB(nullptr), drawHQ(nullptr),
       bufferFormat(BufferFormat::RGBA16F),
-      drawingState(HIGH_QUALITY), yaxisWidth(0), vb(QGLBuffer::VertexBuffer)
+      drawingState(HIGH_QUALITY), yaxisWidth(0), displayHeight(0), vb(QGLBuffer::VertexBuffer)
 {
 	(*ctx)->wait = 1;
 	(*ctx)->reset = 1;
@@ -156,6 +157,7 @@ bool Viewport::tryInitBuffers()
 
 void Viewport::drawBackground(QPainter *painter, const QRectF &rect)
 {
+	TRACE_SPAN("Viewport::drawBackground", "gui");
 	// update geometry
 	int nwidth = painter->device()->width();
 	int nheight = painter->device()->height();
@@ -231,7 +233,8 @@ void Viewport::prepareLines()
 		reset();
 
 	// first step (cpu only)
-	Compute::preparePolylines(**ctx, **sets, shuffleIdx);
+	Compute::preparePolylines(**ctx, **sets, shuffleIdx, binColors,
+	                          displayHeight);
 
 	// second step (cpu -> gpu)
 	target->makeCurrent();
@@ -222,6 +222,8 @@ private:
 	QGLBuffer vb;
 	// index to vertex buffer
 	binindex shuffleIdx;
+	// sRGB colors of bins, kept across rebinning
+	BinColorCache binColors;
 
 	// modelview matrix and its inverse
 	QTransform modelview, modelviewI;
@@ -0,0 +1,164 @@
+#include "bandcache.h"
+
+#include <background_task/tasks/tbb/band2qimagetbb.h>
+
+#include <tbb/blocked_range2d.h>
+#include <tbb/parallel_for.h>
+
+void BandCache::setBudget(size_t b)
+{
+	Lock lock(mutex);
+	budget = b;
+	evict();
+}
+
+void BandCache::clear()
+{
+	Lock lock(mutex);
+	entries.clear();
+	bytes = 0;
+}
+
+size_t BandCache::usage()
+{
+	Lock lock(mutex);
+	return bytes;
+}
+
+void BandCache::validate(const multi_img &image)
+{
+	Lock lock(mutex);
+	QMap<int, Entry>::iterator it = entries.begin();
+	while (it != entries.end()) {
+		int dim = it.key();
+		const multi_img::Band &data = it->data;
+		bool valid = (dim < (int)image.size()
+					  && image[dim].data == data.data
+					  && image[dim].size() == data.size());
+		if (valid) {
+			++it;
+		} else {
+			bytes -= cost(data);
+			it = entries.erase(it);
+		}
+	}
+}
+
+bool BandCache::contains(int dim)
+{
+	Lock lock(mutex);
+	return entries.contains(dim);
+}
+
+bool BandCache::lookup(int dim, multi_img::Value minval,
+					   multi_img::Value maxval, QPixmap &pixmap)
+{
+	Entry entry;
+	{
+		Lock lock(mutex);
+		QMap<int, Entry>::iterator it = entries.find(dim);
+		if (it == entries.end())
+			return false;
+		it->used = ++tick;
+		if (it->minval == minval && it->maxval == maxval
+				&& !it->pixmap.isNull()) {
+			pixmap = it->pixmap;
+			return true;
+		}
+		entry = *it;
+	}
+
+	// re-render from retained data outside the lock
+	if (entry.minval != minval || entry.maxval != maxval) {
+		tbb::task_group_context ctx;
+		render(entry.data, minval, maxval, entry.image, ctx);
+		entry.minval = minval;
+		entry.maxval = maxval;
+	}
+	pixmap = QPixmap::fromImage(entry.image);
+
+	Lock lock(mutex);
+	QMap<int, Entry>::iterator it = entries.find(dim);
+	// entry may have been replaced in the meantime
+	if (it != entries.end() && it->data.data == entry.data.data) {
+		it->minval = minval;
+		it->maxval = maxval;
+		it->image = QImage();
+		it->pixmap = pixmap;
+	}
+	return true;
+}
+
+void BandCache::insert(int dim, const multi_img::Band &data,
+					   multi_img::Value minval, multi_img::Value maxval,
+					   const QImage &image)
+{
+	Lock lock(mutex);
+	QMap<int, Entry>::iterator it = entries.find(dim);
+	if (it != entries.end())
+		bytes -= cost(it->data);
+
+	Entry &entry = entries[dim];
+	entry.data = data;
+	entry.minval = minval;
+	entry.maxval = maxval;
+	entry.image = image;
+	entry.pixmap = QPixmap();
+	entry.used = ++tick;
+	bytes += cost(data);
+
+	evict();
+}
+
+void BandCache::evict()
+{
+	while (bytes > budget && entries.size() > 1) {
+		QMap<int, Entry>::iterator oldest = entries.begin();
+		for (QMap<int, Entry>::iterator it = entries.begin();
+			 it != entries.end(); ++it) {
+			if (it->used < oldest->used)
+				oldest = it;
+		}
+		bytes -= cost(oldest->data);
+		entries.erase(oldest);
+	}
+}
+
+bool BandCache::render(const multi_img::Band &data,
+					   multi_img::Value minval, multi_img::Value maxval,
+					   QImage &image, tbb::task_group_context &ctx)
+{
+	multi_img::Band band = data;
+	image = QImage(band.cols, band.rows, QImage::Format_ARGB32);
+	Band2QImage converter(band, image, minval, maxval);
+	tbb::parallel_for(tbb::blocked_range2d<int>(0, band.rows, 0, band.cols),
+					  converter, tbb::auto_partitioner(), ctx);
+	return !ctx.is_group_execution_cancelled();
+}
+
+bool BandPrefetchTask::run()
+{
+	for (size_t i = 0; i < dims.size(); ++i) {
+		int dim = dims[i];
+		if (cache->contains(dim))
+			continue;
+
+		// take a reference on the band data, do not hold the lock for long
+		multi_img::Band band;
+		multi_img::Value minval, maxval;
+		{
+			SharedDataLock lock(multi->mutex);
+			if (dim < 0 || dim >= (int)(*multi)->size())
+				continue;
+			band = (**multi)[dim];
+			minval = (*multi)->minval;
+			maxval = (*multi)->maxval;
+		}
+
+		QImage image;
+		if (!BandCache::render(band, minval, maxval, image, stopper))
+			return false;
+		cache->insert(dim, band, minval, maxval, image);
+	}
+	return true;
+}
@@ -0,0 +1,129 @@
+#ifndef BANDCACHE_H
+#define BANDCACHE_H
+
+#include <multi_img.h>
+#include <shared_data.h>
+#include <background_task/background_task.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <tbb/task_group.h>
+
+#include <QImage>
+#include <QPixmap>
+#include <QMap>
+#include <vector>
+
+/** Cache of rendered single bands of one representation.
+ *
+ * Memory use is bounded by a budget, least recently used bands are evicted
+ * first. Each entry keeps a (shallow) reference to the float band data it was
+ * rendered from, which counts against the budget. When only the display range of the image changes, bands are
+ * re-rendered from that data instead of being dropped.
+ *
+ * Entries may be added from the background worker thread (prefetching), they
+ * are stored as QImage and converted to QPixmap on first use in the GUI
+ * thread.
+ */
+class BandCache {
+public:
+	/// default memory budget in bytes
+	static const size_t DEFAULT_BUDGET = 128 * 1024 * 1024;
+
+	explicit BandCache(size_t budget = DEFAULT_BUDGET)
+		: budget(budget), bytes(0), tick(0) {}
+
+	/// set memory budget, evicts entries if necessary
+	void setBudget(size_t budget);
+
+	/// drop all entries
+	void clear();
+
+	/// memory used by entries in bytes
+	size_t usage();
+
+	/** Drop entries that do not reference the current band data of image.
+	 *
+	 * Caller needs to hold the image lock.
+	 */
+	void validate(const multi_img &image);
+
+	/// true if band is cached (with any display range)
+	bool contains(int dim);
+
+	/** Retrieve band rendered for display range [minval, maxval].
+	 *
+	 * If the band was rendered for a different range, it is re-rendered from
+	 * the retained float data. Only call from the GUI thread.
+	 * @return false if the band is not in the cache
+	 */
+	bool lookup(int dim, multi_img::Value minval, multi_img::Value maxval,
+				QPixmap &pixmap);
+
+	/// add rendered band, data is the band it was rendered from
+	void insert(int dim, const multi_img::Band &data,
+				multi_img::Value minval, multi_img::Value maxval,
+				const QImage &image);
+
+	/** Render band data to a grayscale image.
+	 *
+	 * @return false if cancelled through ctx
+	 */
+	static bool render(const multi_img::Band &data,
+					   multi_img::Value minval, multi_img::Value maxval,
+					   QImage &image, tbb::task_group_context &ctx);
+
+protected:
+	struct Entry {
+		multi_img::Band data;
+		multi_img::Value minval, maxval;
+		// rendered band, only one of them is kept
+		QImage image;
+		QPixmap pixmap;
+		// time of last use
+		unsigned long used;
+	};
+
+	/* rendered image (4 bytes per pixel) plus the retained band data. The
+	   band is shared with the image only until the image writes to it, then
+	   the cache holds the only copy, so it is always counted. */
+	static size_t cost(const multi_img::Band &data)
+	{ return (size_t)data.rows * data.cols * (4 + sizeof(multi_img::Value)); }
+
+	// evict least recently used entries until budget is met, needs lock
+	void evict();
+
+	typedef boost::mutex Mutex;
+	typedef boost::lock_guard<Mutex> Lock;
+	Mutex mutex;
+
+	QMap<int, Entry> entries;
+	size_t budget, bytes;
+	unsigned long tick;
+};
+
+typedef boost::shared_ptr<BandCache> BandCachePtr;
+
+/** Renders bands into a BandCache in the background.
+ *
+ * Bands already present in the cache are skipped. Intended to run
+ * speculatively, i.e. it holds the image lock only to fetch band headers.
+ */
+class BandPrefetchTask : public BackgroundTask {
+public:
+	BandPrefetchTask(SharedMultiImgPtr multi, BandCachePtr cache,
+					 const std::vector<int> &dims)
+		: BackgroundTask(), multi(multi), cache(cache), dims(dims) {}
+	virtual ~BandPrefetchTask() {}
+	virtual bool run();
+	virtual void cancel() { stopper.cancel_group_execution(); }
+
+protected:
+	tbb::task_group_context stopper;
+
+	SharedMultiImgPtr multi;
+	BandCachePtr cache;
+	std::vector<int> dims;
+};
+
+#endif // BANDCACHE_H
@@ -134,8 +134,13 @@ void ClusteringModel::startSegmentation()
 			config.superpixel.min_size=5;
 			config.superpixel.similarity.function
 					= similarity_measures::SPEC_INF_DIV;
+		} else {
+			// quantized input contains many identical spectra
+			config.unique = true;
 		}
 		config.use_LSH = request->lsh;
+		// determine K, L for the data at hand (followed by segmentation)
+		config.findKL = request->lsh;
 	} else if (ClusteringMethod::FSPMS == request->method) { // FSPMS
 		using namespace seg_meanshift;
 		// Object owned by CommandRunner.
@@ -12,6 +12,7 @@
 #include "commandrunner.h"
 
 #include "falsecolormodel.h"
+#include "memoryaccountant.h"
 #include "falsecolor/falsecolormodelpayload.h"
 #include "sm_factory.h"
 #include "background_task/tasks/tbb/specsimtbb.h"
@@ -29,8 +30,10 @@ QList<FalseColoring::Type> FalseColoring::allList = QList<FalseColoring::Type>()
 	<< FalseColoring::SOMGRAD;
 
 FalseColorModel::FalseColorModel(BackgroundTaskQueue *queue,
+                                 MemoryAccountant *memory,
                                  QObject *parent)
-	: QObject(parent), queue(queue), similarityImg(new SharedData<QImage>(new QImage()))
+	: QObject(parent), queue(queue), memory(memory),
+	  similarityImg(new SharedData<QImage>(new QImage()))
 {
 	int type = QMetaType::type("FalseColoring");
 	if (type == 0 || !QMetaType::isRegistered(type))
@@ -99,7 +102,7 @@ void FalseColorModel::processImageUpdate(representation::t type,
 		FalseColoring::Type coloringType = it.key();
 		if (FalseColoring::isBasedOn(coloringType, type)) {
 			GGDBGM("invalidate cache for " << type << endl);
-			it.value().invalidate();
+			invalidateCache(coloringType);
 		}
 	}
 
@@ -137,11 +140,12 @@ void FalseColorModel::requestColoring(FalseColoring::Type coloringType, bool rec
 		{
 			GGDBGM("have valid cached image, but re-calc requested for "
 				   << coloringType << ", computing" << endl);
-			cache[coloringType].invalidate();
+			invalidateCache(coloringType);
 			computeColoring(coloringType);
 		} else {
 			GGDBGM("have valid cached image for " << coloringType
 				   << ", emitting falseColoringUpdate" << endl);
+			memory->touch(memoryKey(coloringType));
 			emit falseColoringUpdate(coloringType, cacheIt->pixmap());
 		}
 	} else {
@@ -188,10 +192,21 @@ void FalseColorModel::abandonPayload(FalseColoring::Type coloringType) {
 void FalseColorModel::resetCache()
 {
 	for (auto c : FalseColoring::all()) {
-		cache[c].invalidate();
+		invalidateCache(c);
 	}
 }
 
+void FalseColorModel::invalidateCache(FalseColoring::Type coloringType)
+{
+	cache[coloringType].invalidate();
+	memory->release(memoryKey(coloringType));
+}
+
+QString FalseColorModel::memoryKey(FalseColoring::Type coloringType)
+{
+	return QString("false color %1").arg((int)coloringType);
+}
+
 void FalseColorModel::cancelComputation(FalseColoring::Type coloringType)
 {
 	GGDBGM(coloringType<<endl);
@@ -219,6 +234,11 @@ void FalseColorModel::processComputationFinished(FalseColoring::Type coloringTyp
 	if(success) {
 		pixmap = payload->getResult();
 		cache.insert(coloringType,FalseColoringCacheItem(pixmap));
+		// evicted results are recomputed on the next request
+		memory->account(memoryKey(coloringType),
+		                (qint64)pixmap.width() * pixmap.height()
+		                * pixmap.depth() / 8,
+		                [this, coloringType] { cache[coloringType].invalidate(); });
 	}
 	payload->deleteLater();
 	if(success) {
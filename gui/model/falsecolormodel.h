@@ -18,6 +18,7 @@
 
 
 class FalseColorModelPayload;
+class MemoryAccountant;
 
 /**
  * @brief The FalseColorModel class provides false color image processing to
@@ -34,7 +35,8 @@ class FalseColorModel : public QObject
 	Q_OBJECT
 
 public:
-	FalseColorModel(BackgroundTaskQueue *queue, QObject *parent = nullptr);
+	FalseColorModel(BackgroundTaskQueue *queue, MemoryAccountant *memory,
+	                QObject *parent = nullptr);
 	~FalseColorModel();
 
 	void setMultiImg(representation::t repr, SharedMultiImgPtr img);
@@ -100,6 +102,12 @@ private:
 	/** Allocate and reset all cache entries. */
 	void resetCache();
 
+	/** Invalidate cache entry and stop accounting its memory. */
+	void invalidateCache(FalseColoring::Type coloringType);
+
+	// key of a cache entry in the memory accountant
+	static QString memoryKey(FalseColoring::Type coloringType);
+
 	typedef QMap<FalseColoring::Type, FalseColorModelPayload*>
 	FalseColorModelPayloadMap;
 
@@ -118,6 +126,7 @@ private:
 	QMap<representation::t, bool> representationInit;
 
 	BackgroundTaskQueue *const queue;
+	MemoryAccountant *const memory;
 	qimage_ptr similarityImg;
 };
 
@@ -2,17 +2,10 @@
 
 #include <tbb/task_group.h>
 
-#include <background_task/tasks/cuda/gerbil_cuda_util.h>
 #include <background_task/tasks/tbb/illuminanttbb.h>
-#include <background_task/tasks/cuda/illuminantcuda.h>
 
 #include "gerbil_gui_debug.h"
 
-#ifdef GERBIL_CUDA
-	#include <opencv2/gpu/gpu.hpp>
-//	#define USE_CUDA_ILLUMINANT
-#endif
-
 IllumModel::IllumModel(BackgroundTaskQueue *queue, QObject *parent)
 	: QObject(parent), i1(0), i2(0), queue(queue)
 {
@@ -96,10 +89,11 @@ void IllumModel::buildIllum(int t)
 	QVector<multi_img::Value> cf;
 	if (t > 0) {
 		SharedMultiImgBaseGuard guard(*image);
-		il.setNormalization((*image)->meta[0].center,
-					  (*image)->meta[(*image)->size()-1].center);
-		cf = QVector<multi_img::Value>::fromStdVector(
-					(*image)->getIllumCoeff(il));
+		// works on any image type, see multi_img::getIllumCoeff()
+		const std::vector<multi_img::BandDesc> &meta = image->getBase().meta;
+		il.setNormalization(meta[0].center, meta[meta.size()-1].center);
+		for (size_t i = 0; i < meta.size(); ++i)
+			cf.push_back((multi_img::Value)il.at(meta[i].center));
 	}
 	// else: cf is empty vector
 
@@ -111,19 +105,9 @@ void IllumModel::submitRemoveOldIllumTask()
 	/* remove old illuminant */
 	if (i1 != 0) {
 		const Illuminant &il = getIlluminant(i1);
-#ifdef USE_CUDA_ILLUMINANT
-		if (haveCvCudaGpu()) {
-			BackgroundTaskPtr taskIllum(new IlluminantCuda(
-				image, il, true, false));
-			queue->push(taskIllum);
-		} else {
-#else
-		{
-#endif
-			BackgroundTaskPtr taskIllum(new IlluminantTbb(
-				image, il, true, false));
-			queue->push(taskIllum);
-		}
+		// cheap, factors are applied lazily
+		BackgroundTaskPtr taskIllum(new IlluminantTbb(image, il, true));
+		queue->push(taskIllum);
 	}
 }
 
@@ -132,19 +116,7 @@ void IllumModel::submitAddNewIllumTask()
 	/* add new illuminant */
 	if (i2 != 0) {
 		const Illuminant &il = getIlluminant(i2);
-
-#ifdef USE_CUDA_ILLUMINANT
-		if (haveCvCudaGpu()) {
-			BackgroundTaskPtr taskIllum(new IlluminantCuda(
-				image, il, false, false));
-			queue->push(taskIllum);
-		} else {
-#else
-		{
-#endif
-			BackgroundTaskPtr taskIllum(new IlluminantTbb(
-				image, il, false, false));
-			queue->push(taskIllum);
-		}
+		BackgroundTaskPtr taskIllum(new IlluminantTbb(image, il, false));
+		queue->push(taskIllum);
 	}
 }
@@ -1,4 +1,5 @@
 #include "imagemodel.h"
+#include "memoryaccountant.h"
 
 #include "dialogs/openrecent/recentfile.h"
 
@@ -10,7 +11,6 @@
 #include <background_task/tasks/cuda/datarangecuda.h>
 #include <background_task/tasks/cuda/gradientcuda.h>
 #include <background_task/tasks/cuda/normrangecuda.h>
-#include <background_task/tasks/tbb/band2qimagetbb.h>
 #include <background_task/tasks/tbb/datarangetbb.h>
 #include <background_task/tasks/tbb/gradienttbb.h>
 #include <background_task/tasks/tbb/norml2tbb.h>
@@ -20,6 +20,7 @@
 #include <background_task/tasks/tbb/rgbqttbb.h>
 
 #include <multi_img/multi_img_offloaded.h>
+#include <multi_img/multi_img_compact.h>
 #include <imginput.h>
 
 #include <boost/make_shared.hpp>
@@ -31,10 +32,40 @@
 //	#define USE_CUDA_CLAMP
 #endif
 
-ImageModel::ImageModel(BackgroundTaskQueue &queue, bool lm, QObject *parent)
+/* frees or rebuilds representation data in the queue, so tasks queued
+ * before never see a released pixel cache */
+class ImageMemoryTask : public BackgroundTask {
+public:
+	enum Action { Release, ReleasePixels, RebuildPixels };
+
+	ImageMemoryTask(SharedMultiImgPtr image, Action action)
+		: BackgroundTask(), image(image), action(action) {}
+	virtual bool run() {
+		SharedDataSwapLock lock(image->mutex);
+		if (action == Release) {
+			image->replace(new multi_img());
+			return true;
+		}
+		multi_img *img = dynamic_cast<multi_img*>(&image->getBase());
+		if (!img)
+			return false;
+		if (action == ReleasePixels)
+			img->releasePixels();
+		else
+			img->rebuildPixels();
+		return true;
+	}
+
+protected:
+	SharedMultiImgPtr image;
+	Action action;
+};
+
+ImageModel::ImageModel(BackgroundTaskQueue &queue, bool lm,
+                       MemoryAccountant *memory, QObject *parent)
 	: QObject(parent), limitedMode(lm), queue(queue),
 	  image_lim(new SharedMultiImgBase(new multi_img())),
-	  nBands(0), nBandsOld(0)
+	  nBands(0), nBandsOld(0), memory(memory)
 {
 	for (auto r : representation::all()) {
 		map.insert(r, new payload(r));
@@ -44,6 +75,8 @@ ImageModel::ImageModel(BackgroundTaskQueue &queue, bool lm, QObject *parent)
 		connect(p, SIGNAL(newImageData(representation::t,SharedMultiImgPtr)),
 				this,
 				SLOT(processNewImageData(representation::t,SharedMultiImgPtr)));
+		connect(p, SIGNAL(pixelsRebuilt(representation::t)),
+				this, SLOT(updateMemory(representation::t)));
 		connect(p, SIGNAL(dataRangeUpdate(representation::t,multi_img::Range)),
 				this,
 				SIGNAL(observedDataRangeUdpate(representation::t,
@@ -91,10 +124,18 @@ cv::Rect ImageModel::loadImage(const QString &filename)
 		imginput::ImgInputConfig inputConfig;
 		inputConfig.file = fn;
 		multi_img::ptr img = imginput::ImgInput(inputConfig).execute();
-		image_lim = boost::make_shared<SharedMultiImgBase>(img);
+		if (GerbilApplication::instance()->isCompactStorage()) {
+			// quantize, float data is released with img
+			image_lim = boost::make_shared<SharedMultiImgBase>
+					(new multi_img_compact(*img));
+		} else {
+			image_lim = boost::make_shared<SharedMultiImgBase>(img);
+		}
 	}
 
 	multi_img_base &i = image_lim->getBase();
+	// the input image is never evicted
+	memory->account("input image", i.byteSize());
 	if (i.empty()) {
 		GerbilApplication::userError("Image file could not be read.");
 		return cv::Rect();
@@ -139,6 +180,12 @@ void ImageModelPayload::processImageDataTaskFinished(bool success)
 
 }
 
+void ImageModelPayload::processPixelsRebuiltTaskFinished(bool success)
+{
+	if (success)
+		emit pixelsRebuilt(type);
+}
+
 void ImageModel::spawn(representation::t type, const cv::Rect &newROI, int bands)
 {
 	// Store previous state.
@@ -262,13 +309,87 @@ void ImageModel::respawn(representation::t type)
 					 << std::endl;
 		return;
 	}
+	memory->touch(memoryKey(type, "image"));
+
+	// pixel cache was released while unpinned, rebuild before the readers
+	bool released;
+	{
+		SharedDataLock lock(map[type]->image->mutex);
+		multi_img *img =
+				dynamic_cast<multi_img*>(&map[type]->image->getBase());
+		released = (img && !img->empty() && img->pixelsDirty());
+	}
+	if (released) {
+		BackgroundTaskPtr taskRebuild(new ImageMemoryTask(
+			map[type]->image, ImageMemoryTask::RebuildPixels));
+		QObject::connect(taskRebuild.get(), SIGNAL(finished(bool)),
+						 map[type], SLOT(processPixelsRebuiltTaskFinished(bool)),
+						 Qt::QueuedConnection);
+		queue.push(taskRebuild);
+	} else {
+		memory->touch(memoryKey(type, "pixels"));
+	}
 	emit imageUpdate(type, map[type]->image, /* duplicate */ true);
 }
 
+void ImageModel::setPinned(representation::t type, bool pinned)
+{
+	// pixels are read through the image, they cannot be released separately
+	memory->setPinned(memoryKey(type, "image"), pinned);
+	memory->setPinned(memoryKey(type, "pixels"), pinned);
+}
+
+QString ImageModel::memoryKey(representation::t type, const char *item)
+{
+	return QString("%1 %2").arg(representation::str(type)).arg(item);
+}
+
+void ImageModel::updateMemory(representation::t type)
+{
+	SharedMultiImgPtr image = map[type]->image;
+	BandCachePtr cache = map[type]->bands;
+	qint64 total, pixels = 0;
+	{
+		SharedDataLock lock(image->mutex);
+		multi_img_base &base = image->getBase();
+		total = base.byteSize();
+		multi_img *img = dynamic_cast<multi_img*>(&base);
+		if (img)
+			pixels = img->pixelBytes();
+	}
+
+	memory->account(memoryKey(type, "image"), total - pixels,
+	                [this, type] { evict(type); });
+	memory->account(memoryKey(type, "pixels"), pixels,
+	                [this, type] { releasePixels(type); });
+	memory->account(memoryKey(type, "bands"), cache->usage(),
+	                [cache] { cache->clear(); });
+}
+
+void ImageModel::evict(representation::t type)
+{
+	GGDBGM("evicting " << type << endl);
+	memory->release(memoryKey(type, "pixels"));
+	memory->release(memoryKey(type, "bands"));
+	map[type]->bands->clear();
+
+	BackgroundTaskPtr taskRelease(new ImageMemoryTask(
+		map[type]->image, ImageMemoryTask::Release));
+	queue.push(taskRelease);
+	emit representationEvicted(type);
+}
+
+void ImageModel::releasePixels(representation::t type)
+{
+	BackgroundTaskPtr taskRelease(new ImageMemoryTask(
+		map[type]->image, ImageMemoryTask::ReleasePixels));
+	queue.push(taskRelease);
+}
+
 void ImageModel::computeBand(representation::t type, int dim)
 {
 	//GGDBGM(type << " " << dim << endl);
-	QMap<int, QPixmap> &m = map[type]->bands;
+	BandCachePtr cache = map[type]->bands;
 	SharedMultiImgPtr src = map[type]->image;
 	assert(src);
 
@@ -284,21 +405,30 @@ void ImageModel::computeBand(representation::t type, int dim)
 	if((*src)->meta.size() > 0) {
 		banddesc = (*src)->meta[dim].str();
 	}
+
+	// prefetched bands may stem from previous image data
+	cache->validate(**src);
+	multi_img::Value minval = (*src)->minval, maxval = (*src)->maxval;
+	multi_img::Band band;
+	if (dim < size)
+		band = (**src)[dim];
 	hlock.unlock();
 
 	// compute image data if necessary
-	if (!m.contains(dim)) {
-		SharedMultiImgPtr src = map[type]->image;
-		qimage_ptr dest(new SharedData<QImage>(new QImage()));
-
-		SharedDataLock hlock(src->mutex);
-		BackgroundTaskPtr taskConvert(
-					new Band2QImageTbb(src, dest, dim));
-		taskConvert->run();
-		hlock.unlock();
-
-		m[dim] = QPixmap::fromImage(**dest);
+	QPixmap pixmap;
+	if (!cache->lookup(dim, minval, maxval, pixmap)) {
+		QImage image;
+		tbb::task_group_context ctx;
+		BandCache::render(band, minval, maxval, image, ctx);
+		cache->insert(dim, band, minval, maxval, image);
+		if (!cache->lookup(dim, minval, maxval, pixmap))
+			pixmap = QPixmap::fromImage(image);
+		memory->account(memoryKey(type, "bands"), cache->usage(),
+		                [cache] { cache->clear(); });
 	}
+	memory->touch(memoryKey(type, "image"));
+
+	prefetchBands(type, dim, size);
 
 	QString desc;
 	QString typestr = representation::prettyString(type);
@@ -307,7 +437,29 @@ void ImageModel::computeBand(representation::t type, int dim)
 	else
 		desc = QString("%1 Band %2").arg(typestr).arg(banddesc.c_str());
 
-	emit bandUpdate(type, dim, m[dim], desc);
+	emit bandUpdate(type, dim, pixmap, desc);
+}
+
+void ImageModel::prefetchBands(representation::t type, int dim, int size)
+{
+	// number of neighbouring bands to prefetch in each direction
+	static const int radius = 2;
+
+	// speculative work must not delay requested computations
+	if (!queue.isIdle())
+		return;
+
+	std::vector<int> dims;
+	for (int d = 1; d <= radius; ++d) {
+		if (dim + d < size)
+			dims.push_back(dim + d);
+		if (dim - d >= 0)
+			dims.push_back(dim - d);
+	}
+
+	BackgroundTaskPtr taskPrefetch(new BandPrefetchTask(
+		map[type]->image, map[type]->bands, dims));
+	queue.push(taskPrefetch);
 }
 
 void ImageModel::computeFullRgb()
@@ -329,8 +481,16 @@ void ImageModel::setNormalizationParameters(representation::t type,
 void ImageModel::processNewImageData(representation::t type,
 									 SharedMultiImgPtr image)
 {
-	// invalidate band caches
-	map[type]->bands.clear();
+	// invalidate cached bands of replaced data, others are re-rendered
+	// from their retained data on display range changes
+	{
+		SharedDataLock lock(image->mutex);
+		// data was evicted meanwhile, will be spawned again on request
+		if (image->getBase().empty())
+			return;
+		map[type]->bands->validate(**image);
+	}
+	updateMemory(type);
 
 	if (representation::IMG == type) {
 		SharedDataLock lock(image->mutex);
@@ -2,6 +2,7 @@
 #define IMAGE_MODEL_H
 
 #include <model/representation.h>
+#include <model/bandcache.h>
 #include <shared_data.h>
 #include <background_task/background_task_queue.h>
 
@@ -10,6 +11,8 @@
 #include <QPixmap>
 #include <vector>
 
+class MemoryAccountant;
+
 class ImageModelPayload : public QObject {
 	Q_OBJECT
 
@@ -20,7 +23,8 @@ public:
 	ImageModelPayload(representation::t type)
 	    : type(type), image(new SharedMultiImgBase(new multi_img())),
 	      normMode(multi_img::NORM_OBSERVED),
-	      normRange(new SharedData<multi_img::Range>(new multi_img::Range()))
+	      normRange(new SharedData<multi_img::Range>(new multi_img::Range())),
+	      bands(new BandCache())
 	{}
 
 	// the type we have
@@ -33,19 +37,22 @@ public:
 	multi_img::NormMode normMode;
 	SharedMultiImgRangePtr normRange;
 
-	// cached single bands
-	QMap<int, QPixmap> bands;
+	// cached single bands, also filled by prefetching
+	BandCachePtr bands;
 
 public slots:
 	// This slot is connected to the epilog task in Image::spawn() and in turn
 	// emits the signals newImageData() and dataRangeUpdate() in this order.
 	void processImageDataTaskFinished(bool success);
+	// emits pixelsRebuilt() after the pixel cache was rebuilt in the queue
+	void processPixelsRebuiltTaskFinished(bool success);
 
 signals:
 	// newImageData() and dataRangeUpdate are availabe to ImageModel clients
 	// as ImageModel::imageUpdate() and ImageModel::dataRangeUpdate().
 	void newImageData(representation::t type, SharedMultiImgPtr image);
 	void dataRangeUpdate(representation::t type, multi_img::Range range);
+	void pixelsRebuilt(representation::t type);
 };
 
 class ImageModel : public QObject
@@ -56,7 +63,8 @@ public:
 
 	typedef ImageModelPayload payload;
 
-	explicit ImageModel(BackgroundTaskQueue &queue, bool limitedMode, QObject *parent = nullptr);
+	explicit ImageModel(BackgroundTaskQueue &queue, bool limitedMode,
+	                    MemoryAccountant *memory, QObject *parent = nullptr);
 	~ImageModel();
 
 	/** Return the number of bands in the input image.
@@ -120,6 +128,13 @@ public:
 	 */
 	void respawn(representation::t type);
 
+	/** Keep representation data regardless of the memory budget.
+	 *
+	 * Representations in use must be pinned. Unpinned representations may be
+	 * evicted, which is signalled by representationEvicted().
+	 */
+	void setPinned(representation::t type, bool pinned);
+
 public slots:
 
 	void computeBand(representation::t type, int dim);
@@ -191,19 +206,39 @@ signals:
 	 */
 	void roiRectChanged(cv::Rect roi);
 
+	/** The ROI image data for representation type was freed to meet the
+	 * memory budget. It needs to be spawned again before use.
+	 */
+	void representationEvicted(representation::t type);
+
 protected slots:
 
 	// payload background task has finished
 	void processNewImageData(representation::t type, SharedMultiImgPtr image);
 
+	// account image data, pixel cache and band cache of representation
+	void updateMemory(representation::t type);
+
 private:
 
 	// Computes RGB image of full image (ignoring ROI).
 	QPixmap fullRgb();
 
+	// render bands around dim in the background if the queue is idle
+	void prefetchBands(representation::t type, int dim, int size);
+
 	// helper to spawn()
 	bool checkProfitable(const cv::Rect& oldROI, const cv::Rect& newROI);
 
+	// key of a representation's item in the memory accountant
+	static QString memoryKey(representation::t type, const char *item);
+
+	// free representation data (evictor)
+	void evict(representation::t type);
+
+	// free pixel cache of representation (evictor)
+	void releasePixels(representation::t type);
+
 	// FIXME rename
 	SharedMultiImgPtr image_lim; // big one
 
@@ -226,6 +261,8 @@ private:
 	size_t nBandsOld;
 
 	BackgroundTaskQueue &queue;
+
+	MemoryAccountant *memory;
 };
 
 #endif // IMAGE_MODEL_H
@@ -2,11 +2,12 @@
 #include <QImage>
 #include <QPainter>
 
-#include <opencv2/imgproc/imgproc.hpp>
-
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 #include <qtopencv.h>
 
@@ -46,11 +47,9 @@ int clamp(const int& val, const int& min, const int& max)
 }
 
 
-// TBB functor
-class ComputeIconMasks {
-public:
-	ComputeIconMasks(IconTaskCtx& ctx)
-		: ctx(ctx)
+/* placement of the label matrix inside the icons */
+struct IconLayout {
+	IconLayout(const IconTaskCtx& ctx)
 	{
 		// clamp the icon size
 		iconSizecv = cv::Size(
@@ -60,10 +59,8 @@ public:
 						  IconTask::IconSizeMin, IconTask::IconSizeMax));
 
 		// inner size = icon size without border (fixed to 1px)
-		innerSize = QSize(iconSizecv.width - 2,
-						  iconSizecv.height - 2);
-
-		innerSizecv = cv::Size(innerSize.width(), innerSize.height());
+		innerSizecv = cv::Size(iconSizecv.width - 2,
+							   iconSizecv.height - 2);
 
 		if (ctx.applyROI) {
 			labels = ctx.roi_labels;
@@ -77,50 +74,130 @@ public:
 		dx = 0.5 * (float(iconSizecv.width) - labels.cols*scale);
 		dy = 0.5 * (float(iconSizecv.height) - labels.rows*scale);
 
-		// affine trafo matrix
-		trafo = cv::Mat1f::zeros(2,3);
-		trafo(0,0) = scale;
-		trafo(1,1) = scale;
-		trafo(0,2) = dx;
-		trafo(1,2) = dy;
-
 		// rect of the transformed mask in the icon
-		drect = QRectF(dx, dy,
-					   labels.cols*scale, labels.rows*scale);
+		QRectF drect(dx, dy, labels.cols*scale, labels.rows*scale);
 		// rect of the border around the transformed mask
 		brect = QRectF(drect.left(), drect.top(),
 					   drect.width()-1, drect.height()-1);
+	}
+
+	//! The label matrix, either ctx.full_labels or ctx.roi_labels, depending
+	//! on ctx.applyROI.
+	cv::Mat1s labels;
+	//! Icon size as cv::Size
+	cv::Size iconSizecv;
+	//! Icon inner size without border
+	cv::Size innerSizecv;
+	//! Scale factor from image to inner icon size
+	float scale;
+	//! icon offset in x-dir
+	float dx;
+	//! icon offset in y-dir
+	float dy;
+	//! Rect of the border drawn around the transformed mask.
+	QRectF brect;
+};
+
+/* overlap of a source pixel with one icon pixel along one axis */
+struct Overlap {
+	int pos;
+	float weight;
+};
 
-//		GGDBGM("desired icon size " << iconSizecv << endl);
-//		GGDBGM("scale " << scale << endl);
-//		GGDBGM("dx " << dx << endl);
-//		GGDBGM("dy " << dy << endl);
-//		GGDBGM("scaled mask size " << innerSizecv << endl);
+//! Overlaps of the source interval [offset + i*scale, offset + (i+1)*scale)
+//! with the icon pixels [pos, pos+1) in 0..size-1.
+static void overlaps(int i, float scale, float offset, int size,
+					 std::vector<Overlap> &out)
+{
+	const float a = offset + i*scale, b = a + scale;
+	for (int pos = std::max((int)std::floor(a), 0);
+		 pos < std::min((int)std::ceil(b), size); ++pos) {
+		Overlap o = { pos, std::min(b, pos + 1.f) - std::max(a, (float)pos) };
+		if (o.weight > 0.f)
+			out.push_back(o);
 	}
+}
 
-	void operator()(const tbb::blocked_range<short>& range) const {
-		for (short labelid=range.begin(); labelid!=range.end(); ++labelid) {
-			// Compute mask.
-			// For big images it might make sense to parallelize this on a
-			// smaller granularity (pixel ranges).
-			// And it might be a good idea to cache these.
-			cv::Mat1b mask(labels == labelid);
+/* scatters the area of each label pixel into per-label coverage maps
+ * (area averaging, like INTER_AREA). Every icon row is accumulated from the
+ * label rows overlapping it, so one pass serves all labels and icon rows can
+ * be processed independently. */
+class AccumulateCoverage {
+public:
+	AccumulateCoverage(const IconLayout& layout, std::vector<cv::Mat1f>& cover)
+		: layout(layout), cover(cover)
+	{
+		// column overlaps are the same for every row, prepare them once
+		const cv::Mat1s &labels = layout.labels;
+		colStart.push_back(0);
+		for (int x = 0; x < labels.cols; ++x) {
+			overlaps(x, layout.scale, layout.dx, layout.iconSizecv.width,
+					 cols);
+			colStart.push_back(cols.size());
+		}
+	}
 
+	void operator()(const tbb::blocked_range<int>& range) const {
+		const cv::Mat1s &labels = layout.labels;
+		const int nlabels = cover.size();
+		for (int iy = range.begin(); iy != range.end(); ++iy) {
 			if(tbb::task::self().is_cancelled()) {
-				//GGDBGM("aborted through tbb cancel." << endl);
 				return;
 			}
 
-			// transform mask into icon
-			cv::Mat1b masktrf = cv::Mat1b::zeros(iconSizecv);
-			cv::warpAffine(mask, masktrf, trafo, iconSizecv, CV_INTER_AREA);
+			// label rows overlapping this icon row
+			int ybegin = std::floor((iy - layout.dy) / layout.scale);
+			int yend = std::ceil((iy + 1 - layout.dy) / layout.scale);
+			ybegin = std::max(ybegin, 0);
+			yend = std::min(yend, labels.rows);
+			for (int y = ybegin; y < yend; ++y) {
+				const float a = layout.dy + y*layout.scale;
+				const float wy = std::min(a + layout.scale, iy + 1.f)
+						- std::max(a, (float)iy);
+				if (wy <= 0.f)
+					continue;
+
+				const short *lrow = labels[y];
+				for (int x = 0; x < labels.cols; ++x) {
+					const short label = lrow[x];
+					if (label < 0 || label >= nlabels)
+						continue;
+					float *crow = cover[label][iy];
+					for (size_t c = colStart[x]; c < colStart[x + 1]; ++c)
+						crow[cols[c].pos] += cols[c].weight * wy;
+				}
+			}
+		}
+	}
+private:
+	const IconLayout& layout;
+	std::vector<cv::Mat1f>& cover;
+	//! column overlaps of all label columns, and start of each column
+	std::vector<Overlap> cols;
+	std::vector<size_t> colStart;
+};
 
+// TBB functor
+class ComputeIconMasks {
+public:
+	ComputeIconMasks(IconTaskCtx& ctx, const IconLayout& layout,
+					 const std::vector<cv::Mat1f>& cover)
+		: ctx(ctx), layout(layout), cover(cover)
+	{}
+
+	void operator()(const tbb::blocked_range<short>& range) const {
+		const cv::Size &iconSizecv = layout.iconSizecv;
+		for (short labelid=range.begin(); labelid!=range.end(); ++labelid) {
 			if(tbb::task::self().is_cancelled()) {
 				//GGDBGM("aborted through tbb cancel." << endl);
 				return;
 			}
 			// The rest is probably too fast to allow checking for cancellation.
 
+			// coverage of the icon pixels is the alpha channel
+			cv::Mat1b masktrf;
+			cover[labelid].convertTo(masktrf, CV_8U, 255.);
+
 			QColor color = ctx.colors.at(labelid);
 
 			// Fill icon with solid color in ARGB format.
@@ -152,33 +229,16 @@ public:
 			// ensure border visibility, fixed to 1px
 			pen.setWidthF(1.f);
 			p.setPen(pen);
-			p.drawRect(brect);
+			p.drawRect(layout.brect);
 
 			ctx.icons[labelid] = qimage;
 		}
 	}
 private:
 	IconTaskCtx& ctx;
-	//! The label matrix, either ctx.full_labels or ctx.roi_labels, depending
-	//! on ctx.applyROI.
-	cv::Mat1s labels;
-	//! Icon size as cv::Size
-	cv::Size iconSizecv;
-	//! Icon inner size without border
-	QSize innerSize;
-	cv::Size innerSizecv;
-	//! Scale factor from image to inner icon size
-	float scale;
-	//! icon offset in x-dir
-	float dx;
-	//! icon offset in y-dir
-	float dy;
-	//! Affine trafo using the above scale and offsets.
-	cv::Mat1f trafo;
-	//! Rect of the transformed mask.
-	QRectF drect;
-	//! Rect of the border drawn around the transformed mask.
-	QRectF brect;
+	const IconLayout& layout;
+	//! per-label coverage of the icon pixels, 0..1
+	const std::vector<cv::Mat1f>& cover;
 };
 
 IconTask::IconTask(IconTaskCtxPtr &ctxp, QObject *parent)
@@ -233,8 +293,22 @@ void IconTask::run()
 		return;
 	}
 
+	// one pass over the labeling for all labels
+	IconLayout layout(ctx);
+	std::vector<cv::Mat1f> cover(ctx.nlabels);
+	for (int i = 0; i < ctx.nlabels; ++i)
+		cover[i] = cv::Mat1f::zeros(layout.iconSizecv);
+	tbb::parallel_for(tbb::blocked_range<int>(0, layout.iconSizecv.height),
+					  AccumulateCoverage(layout, cover),
+					  partitioner, tbbTaskGroupContext);
+
+	if (abortFlag) {
+		return;
+	}
+
 	tbb::parallel_for(tbb::blocked_range<short>(0, ctx.nlabels),
-					  ComputeIconMasks(ctx), partitioner, tbbTaskGroupContext);
+					  ComputeIconMasks(ctx, layout, cover),
+					  partitioner, tbbTaskGroupContext);
 
 	if (!abortFlag) {
 		emit labelIconsComputed(ctx.icons);
@@ -0,0 +1,84 @@
+#include "memoryaccountant.h"
+
+//#define GGDBG_MODULE
+#include "../gerbil_gui_debug.h"
+
+MemoryAccountant::MemoryAccountant(QObject *parent)
+	: QObject(parent), budget(0), bytes(0), tick(0)
+{
+}
+
+void MemoryAccountant::account(const QString &key, qint64 size,
+							   Evictor evict)
+{
+	Item &item = items[key];
+	bytes += size - item.size;
+	item.size = size;
+	item.used = ++tick;
+	item.pinned = pins.value(key, false);
+	item.evict = evict;
+	enforce();
+	emit usageChanged(bytes, budget);
+}
+
+void MemoryAccountant::touch(const QString &key)
+{
+	QMap<QString, Item>::iterator it = items.find(key);
+	if (it != items.end())
+		it->used = ++tick;
+}
+
+void MemoryAccountant::setPinned(const QString &key, bool pinned)
+{
+	pins[key] = pinned;
+	QMap<QString, Item>::iterator it = items.find(key);
+	if (it == items.end())
+		return;
+	it->pinned = pinned;
+	if (!pinned) {
+		enforce();
+		emit usageChanged(bytes, budget);
+	}
+}
+
+void MemoryAccountant::release(const QString &key)
+{
+	QMap<QString, Item>::iterator it = items.find(key);
+	if (it == items.end())
+		return;
+	bytes -= it->size;
+	items.erase(it);
+	emit usageChanged(bytes, budget);
+}
+
+void MemoryAccountant::setBudget(qint64 b)
+{
+	budget = b;
+	enforce();
+	emit usageChanged(bytes, budget);
+}
+
+void MemoryAccountant::enforce()
+{
+	while (budget > 0 && bytes > budget) {
+		QMap<QString, Item>::iterator oldest = items.end();
+		for (QMap<QString, Item>::iterator it = items.begin();
+			 it != items.end(); ++it) {
+			if (it->pinned || !it->evict)
+				continue;
+			if (oldest == items.end() || it->used < oldest->used)
+				oldest = it;
+		}
+		if (oldest == items.end())
+			return; // nothing left to evict
+
+		GGDBGM("evicting " << oldest.key().toStdString() << ", "
+			   << oldest->size << " bytes" << std::endl);
+		/* remove the item before calling the evictor, which may release
+		   other items */
+		Evictor evict = oldest->evict;
+		bytes -= oldest->size;
+		items.erase(oldest);
+		evict();
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef MEMORYACCOUNTANT_H
+#define MEMORYACCOUNTANT_H
+
+#include <QObject>
+#include <QMap>
+#include <QString>
+
+#include <functional>
+
+/** Central bookkeeping of memory held by models.
+ *
+ * Models account their large data items (representations, pixel caches,
+ * rendered results) under a unique key. When the total exceeds the budget,
+ * the least recently used evictable items are evicted: their evictor is
+ * called, which frees the data or schedules its release, and their bytes are
+ * no longer accounted. Evicted data is recomputed lazily by its model.
+ *
+ * Items without evictor and pinned items are never evicted. Only use from
+ * the GUI thread.
+ */
+class MemoryAccountant : public QObject
+{
+	Q_OBJECT
+
+public:
+	typedef std::function<void()> Evictor;
+
+	explicit MemoryAccountant(QObject *parent = nullptr);
+
+	/// memory budget in bytes, 0 means unlimited
+	qint64 getBudget() const { return budget; }
+	/// bytes currently accounted
+	qint64 getUsage() const { return bytes; }
+
+	/** Add or update an item, it counts as recently used.
+	 *
+	 * @param evict called when the item is evicted (may be empty)
+	 */
+	void account(const QString &key, qint64 size,
+				 Evictor evict = Evictor());
+
+	/// mark item as recently used
+	void touch(const QString &key);
+
+	/// pinned items are kept regardless of the budget
+	void setPinned(const QString &key, bool pinned);
+
+	/// remove item, e.g. after its data was freed by its owner
+	void release(const QString &key);
+
+public slots:
+	/// set memory budget in bytes (0 means unlimited), evicts if necessary
+	void setBudget(qint64 budget);
+
+signals:
+	/// accounted memory or budget changed
+	void usageChanged(qint64 usage, qint64 budget);
+
+protected:
+	struct Item {
+		Item() : size(0), used(0), pinned(false) {}
+		qint64 size;
+		// time of last use
+		unsigned long used;
+		bool pinned;
+		Evictor evict;
+	};
+
+	// evict least recently used items until budget is met
+	void enforce();
+
+	QMap<QString, Item> items;
+	qint64 budget, bytes;
+	unsigned long tick;
+	// pinned state of items that are not accounted (yet)
+	QMap<QString, bool> pins;
+};
+
+#endif // MEMORYACCOUNTANT_H
@@ -23,14 +23,20 @@
 #include <QFileInfo>
 #include <QMenu>
 #include <QSettings>
+#include <QLabel>
+#include <QStatusBar>
+#include <QInputDialog>
 
 #include <iostream>
 
 MainWindow::MainWindow()
-    : contextMenu(NULL)
+    : contextMenu(NULL), memoryBudget(0)
 {
 	// create all objects
 	setupUi(this);
+
+	memoryLabel = new QLabel(this);
+	statusBar()->addPermanentWidget(memoryLabel);
 }
 
 void MainWindow::initUI(const QString &filename)
@@ -102,9 +108,33 @@ void MainWindow::openContextMenu()
 {
 	delete contextMenu;
 	contextMenu = createPopupMenu();
+	contextMenu->addSeparator();
+	contextMenu->addAction("Set memory budget…",
+	                       this, SLOT(requestMemoryBudget()));
 	contextMenu->exec(QCursor::pos());
 }
 
+void MainWindow::updateMemoryUsage(qint64 usage, qint64 budget)
+{
+	const qint64 mb = 1024 * 1024;
+	memoryBudget = budget;
+	QString text = QString("Memory: %1 MB").arg(usage / mb);
+	if (budget > 0)
+		text += QString(" / %1 MB").arg(budget / mb);
+	memoryLabel->setText(text);
+}
+
+void MainWindow::requestMemoryBudget()
+{
+	bool ok;
+	int mb = QInputDialog::getInt(this, "Memory Budget",
+	                              "Memory budget in MB (0: unlimited):",
+	                              (int)(memoryBudget / (1024 * 1024)),
+	                              0, 1024 * 1024, 64, &ok);
+	if (ok)
+		emit memoryBudgetRequested((qint64)mb * 1024 * 1024);
+}
+
 void MainWindow::screenshot()
 {
 	// grabWindow reads from the display server, so GL parts are not missing
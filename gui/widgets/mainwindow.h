@@ -12,6 +12,8 @@
 
 #include "ui_mainwindow.h"
 
+class QLabel;
+
 class MainWindow : public QMainWindow, private Ui::MainWindow {
 	Q_OBJECT
 public:
@@ -27,6 +29,14 @@ public slots:
 
 	void screenshot();
 
+	// show memory usage and budget (in bytes, 0: unlimited)
+	void updateMemoryUsage(qint64 usage, qint64 budget);
+	// ask the user for a new memory budget
+	void requestMemoryBudget();
+
+signals:
+	void memoryBudgetRequested(qint64 budget);
+
 protected:
 
 	void closeEvent (QCloseEvent * event) override;
@@ -34,6 +44,8 @@ protected:
 
 private:
 	QMenu *contextMenu;
+	QLabel *memoryLabel;
+	qint64 memoryBudget;
 };
 
 #endif // MAINWINDOW_H
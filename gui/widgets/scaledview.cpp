@@ -9,6 +9,7 @@
 #include "scaledview.h"
 
 #include <stopwatch.h>
+#include <trace.h>
 #include <QApplication>
 #include <QPainter>
 #include <QGraphicsSceneEvent>
@@ -56,6 +57,7 @@ void ScaledView::setPixmap(QPixmap p)
 
 void ScaledView::drawBackground(QPainter *painter, const QRectF &rect)
 {
+	TRACE_SPAN("ScaledView::drawBackground", "gui");
 	// update geometry
 	int nwidth = painter->device()->width();
 	int nheight = painter->device()->height();
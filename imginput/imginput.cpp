@@ -1,6 +1,6 @@
 #include "imginput.h"
 #include "gdalreader.h"
-#include <multi_img/illuminant.h>
+#include "preprocessing.h"
 #include <string>
 #include <vector>
 #include <boost/make_shared.hpp>
@@ -37,7 +37,8 @@ multi_img::ptr ImgInput::execute()
 	if (img_ptr->empty())
 		return img_ptr;
 
-	// apply ROI
+	// region of interest
+	cv::Rect roi(0, 0, img_ptr->width, img_ptr->height);
 	if (!roiChanged && !config.roi.empty())
 	{
 		std::vector<int> roiVals;
@@ -45,38 +46,21 @@ multi_img::ptr ImgInput::execute()
 			// Parsing of ROI String failed
 			std::cerr << "Ignoring invalid ROI specification" << std::endl;
 		} else {
-			applyROI(*img_ptr, roiVals);
+			roi = cv::Rect(roiVals[0], roiVals[1], roiVals[2], roiVals[3]);
 		}
 	}
 
 	// crop spectrum - maybe we used a fancy file reader that cropped the bands already
-	if (!bandsCropped)
-		cropSpectrum(*img_ptr);
+	int bandlow = 0, bandhigh = img_ptr->size() - 1;
+	if (!bandsCropped && !cropSpectrum(*img_ptr, bandlow, bandhigh))
+		return multi_img::ptr(new multi_img()); // empty image
 
-	// return empty image on failure
-	if (img_ptr->empty())
+	/* ROI, cropping, normalization, gradient, band reduction and
+	   illumination are applied in a single pass */
+	Preprocessing preprocessing(config, *img_ptr, roi, bandlow, bandhigh);
+	if (preprocessing.identity())
 		return img_ptr;
-
-	// normalize L2 magnitudes
-	if (config.normalize) {
-		img_ptr->normalize_magnitudes();
-	}
-
-	// compute gradient
-	if (config.gradient) {
-		img_ptr->apply_logarithm();
-		*img_ptr = img_ptr->spec_gradient();
-	}
-
-	// reduce number of bands
-	if (config.bands > 0 && config.bands < (int)img_ptr->size()) {
-		*img_ptr = img_ptr->spec_rescale(config.bands);
-	}
-
-	// alter illumination
-	applyIllumination(*img_ptr);
-
-	return img_ptr;
+	return preprocessing.execute();
 }
 
 multi_img::ptr ImgInput::load(const std::string &filename)
@@ -99,45 +83,25 @@ bool ImgInput::parseROIString(const std::string &str, std::vector<int> &vals)
 	return ctr == 3;
 }
 
-void ImgInput::applyROI(multi_img &img, std::vector<int>& vals)
-{
-	img = multi_img(img, cv::Rect(vals[0], vals[1], vals[2], vals[3]));
-}
-
-void ImgInput::cropSpectrum(multi_img& img)
+bool ImgInput::cropSpectrum(const multi_img &img, int &bandlow, int &bandhigh)
 {
 	if ((config.bandlow > 0) ||
 		(config.bandhigh > 0 && config.bandhigh < (int)img.size() - 1)) {
 
 		// if bandhigh is not specified, do not limit
-		int bandhigh =
+		bandhigh =
 		        (config.bandhigh == 0) ? (img.size() - 1) : config.bandhigh;
 
 		// correct input?
 		if (config.bandlow > bandhigh || bandhigh > (int)img.size() - 1) {
 			std::cerr << "Inconsistent bandlow, bandhigh values specified!"
 			          << std::endl;
-			img = multi_img();
-			return;
+			return false;
 		}
 
-        img = multi_img(img, config.bandlow, bandhigh);
-	}
-}
-
-void ImgInput::applyIllumination(multi_img &img)
-{
-	if (config.removeIllum > 0) {
-		Illuminant il(config.removeIllum);
-		// first get normalization right for our range
-		il.setNormalization(img.meta[0].center, img.meta[img.size()-1].center);
-		img.apply_illuminant(il, true);
-	}
-	if (config.addIllum > 0) {
-		Illuminant il(config.addIllum);
-		il.setNormalization(img.meta[0].center, img.meta[img.size()-1].center);
-		img.apply_illuminant(il);
+		bandlow = config.bandlow;
 	}
+	return true;
 }
 
 } //namespace
@@ -21,11 +21,8 @@ public:
 private:
 	const ImgInputConfig &config;
 
-	void applyROI(multi_img &img, std::vector<int> &vals);
-
-	void cropSpectrum(multi_img &img);
-
-	void applyIllumination(multi_img& img_ptr);
+	// determine band range to keep, returns false on invalid configuration
+	bool cropSpectrum(const multi_img &img, int &bandlow, int &bandhigh);
 };
 
 } // namespace
@@ -0,0 +1,199 @@
+#include "preprocessing.h"
+#include <multi_img/illuminant.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <cstring>
+#include <cmath>
+
+namespace imginput {
+
+/* pixels per tile, keeps the tile of all bands in cache */
+static const int TILE_PIXELS = 1024;
+
+static inline int tileRows(int width)
+{
+	return std::max(1, TILE_PIXELS / width);
+}
+
+Preprocessing::Preprocessing(const ImgInputConfig &config,
+							 const multi_img &source, const cv::Rect &roi,
+							 int bandlow, int bandhigh)
+	: source(source), roi(roi), bandlow(bandlow), bandhigh(bandhigh),
+	  normalize(config.normalize), logarithm(false),
+	  meta(source.meta.begin() + bandlow, source.meta.begin() + bandhigh + 1),
+	  minval(source.minval), maxval(source.maxval)
+{
+	int n = bandhigh - bandlow + 1;
+
+	// compute gradient: logarithm, followed by differences
+	if (config.gradient) {
+		logarithm = true;
+		transform = cv::Mat1f::zeros(std::max(n - 1, 0), n);
+		std::vector<multi_img::BandDesc> gradmeta(transform.rows);
+		for (int i = 0; i < transform.rows; ++i) {
+			transform(i, i) = -1.f;
+			transform(i, i + 1) = 1.f;
+			if (!meta[i].empty && !meta[i+1].empty)
+				gradmeta[i] = multi_img::BandDesc(meta[i].center,
+												  meta[i+1].center);
+		}
+		meta.swap(gradmeta);
+		// data format as of apply_logarithm() and spec_gradient()
+		maxval = std::log(maxval);
+		minval = -maxval;
+	}
+
+	// reduce number of bands
+	if (config.bands > 0 && config.bands < (int)meta.size()) {
+		cv::Mat1f weights =
+				multi_img::spec_rescale_weights(meta.size(), config.bands);
+		meta = multi_img::spec_rescale_meta(meta, config.bands);
+		if (transform.empty())
+			transform = weights;
+		else
+			transform = weights * transform;
+	}
+
+	// alter illumination
+	if (config.removeIllum > 0)
+		applyIlluminant(config.removeIllum, true);
+	if (config.addIllum > 0)
+		applyIlluminant(config.addIllum, false);
+}
+
+void Preprocessing::applyIlluminant(int temperature, bool remove)
+{
+	if (meta.empty())
+		return;
+
+	Illuminant il(temperature);
+	// first get normalization right for our range
+	il.setNormalization(meta[0].center, meta[meta.size()-1].center);
+
+	if (transform.empty())
+		transform = cv::Mat1f::eye(meta.size(), bandhigh - bandlow + 1);
+	for (size_t i = 0; i < meta.size(); ++i) {
+		// if meta was not set, center is 0., and il.at() will throw assert :)
+		multi_img::Value factor = (multi_img::Value)il.at(meta[i].center);
+		if (remove)
+			factor = 1.f / factor;
+		cv::Mat1f row = transform.row(i);
+		row *= factor;
+	}
+}
+
+bool Preprocessing::identity() const
+{
+	return roi == cv::Rect(0, 0, source.width, source.height)
+			&& bandlow == 0 && bandhigh == (int)source.size() - 1
+			&& !normalize && !logarithm && transform.empty();
+}
+
+/* applies the compiled steps to tiles of rows */
+class PreprocessTiles {
+public:
+	PreprocessTiles(const std::vector<multi_img::Band> &planes,
+					bool normalize, bool logarithm,
+					const cv::Mat1f &transform,
+					std::vector<multi_img::Band> &target)
+		: planes(planes), normalize(normalize), logarithm(logarithm),
+		  transform(transform), target(target) {}
+
+	void operator()(const tbb::blocked_range<int> &r) const
+	{
+		const int width = planes[0].cols;
+		const int tilerows = tileRows(width);
+
+		cv::Mat1f tile, result;
+		std::vector<double> norms;
+		for (int y = r.begin(); y < r.end(); y += tilerows) {
+			const int rows = std::min(tilerows, r.end() - y);
+			const int npix = rows * width;
+
+			// gather spectra of the tile
+			tile.create(planes.size(), npix);
+			for (size_t b = 0; b < planes.size(); ++b) {
+				float *dst = tile[b];
+				for (int row = y; row < y + rows; ++row, dst += width)
+					std::memcpy(dst, planes[b][row], width * sizeof(float));
+			}
+
+			// normalize L2 magnitudes
+			if (normalize) {
+				norms.assign(npix, 0.);
+				for (int b = 0; b < tile.rows; ++b) {
+					const float *src = tile[b];
+					for (int i = 0; i < npix; ++i)
+						norms[i] += (double)src[i] * src[i];
+				}
+				for (int i = 0; i < npix; ++i)
+					norms[i] = (norms[i] > 0. ? 1. / std::sqrt(norms[i]) : 1.);
+				for (int b = 0; b < tile.rows; ++b) {
+					float *dst = tile[b];
+					for (int i = 0; i < npix; ++i)
+						dst[i] = (float)(dst[i] * norms[i]);
+				}
+			}
+
+			// logarithm, getting rid of negative values (value was < 1)
+			if (logarithm) {
+				for (int b = 0; b < tile.rows; ++b) {
+					float *dst = tile[b];
+					for (int i = 0; i < npix; ++i) {
+						float v = std::log(std::abs(dst[i]));
+						dst[i] = (v > 0.f ? v : 0.f);
+					}
+				}
+			}
+
+			// linear spectral steps
+			const cv::Mat1f *out = &tile;
+			if (!transform.empty()) {
+				cv::gemm(transform, tile, 1., cv::noArray(), 0., result);
+				out = &result;
+			}
+
+			// scatter into target bands
+			for (size_t b = 0; b < target.size(); ++b) {
+				const float *src = (*out)[b];
+				for (int row = y; row < y + rows; ++row, src += width)
+					std::memcpy(target[b][row], src, width * sizeof(float));
+			}
+		}
+	}
+
+private:
+	const std::vector<multi_img::Band> &planes;
+	bool normalize, logarithm;
+	const cv::Mat1f &transform;
+	std::vector<multi_img::Band> &target;
+};
+
+multi_img::ptr Preprocessing::execute() const
+{
+	// band headers of the region to process
+	std::vector<multi_img::Band> planes;
+	for (int b = bandlow; b <= bandhigh; ++b)
+		planes.push_back(multi_img::Band(source[b], roi));
+
+	multi_img::ptr target(new multi_img(roi.height, roi.width, meta.size()));
+	target->roi = roi;
+	target->meta = meta;
+	target->minval = minval;
+	target->maxval = maxval;
+	if (planes.empty() || meta.empty() || roi.area() == 0)
+		return target;
+
+	std::vector<multi_img::Band> bands(meta.size());
+	for (size_t b = 0; b < bands.size(); ++b)
+		target->getBand(b, bands[b]);
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, roi.height, tileRows(roi.width)),
+		PreprocessTiles(planes, normalize, logarithm, transform, bands));
+
+	return target;
+}
+
+} // namespace
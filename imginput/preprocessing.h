@@ -0,0 +1,56 @@
+#ifndef PREPROCESSING_H
+#define PREPROCESSING_H
+
+#include "imginput_config.h"
+#include <multi_img.h>
+#include <vector>
+
+namespace imginput {
+
+/**
+ * Preprocessing steps of ImgInput, fused into a single pass.
+ *
+ * The configured steps (ROI, band crop, L2 normalization, spectral gradient,
+ * spectral rescaling, illuminant change) are compiled for the layout of the
+ * source image. Normalization and logarithm are applied on tiles of spectra,
+ * while the spectrally linear steps (gradient, rescaling, illuminant) are
+ * folded into one matrix applied afterwards. Tiles of rows are processed in
+ * parallel, the result is written once.
+ */
+class Preprocessing {
+public:
+	/** Compile steps for the source image.
+	 *
+	 * @arg roi region of the source to process
+	 * @arg bandlow, bandhigh range of source bands to process (inclusive)
+	 */
+	Preprocessing(const ImgInputConfig &config, const multi_img &source,
+				  const cv::Rect &roi, int bandlow, int bandhigh);
+
+	/// true if the result would equal the source image
+	bool identity() const;
+
+	/// compute the result, the source image is not altered
+	multi_img::ptr execute() const;
+
+protected:
+	// adds illuminant factors to transform (multiply, or divide if remove)
+	void applyIlluminant(int temperature, bool remove);
+
+	const multi_img &source;
+	cv::Rect roi;
+	int bandlow, bandhigh;
+
+	bool normalize;
+	bool logarithm;
+	// linear spectral transform (#output x #input bands), empty if none
+	cv::Mat1f transform;
+
+	// properties of the result
+	std::vector<multi_img::BandDesc> meta;
+	multi_img::Value minval, maxval;
+};
+
+} // namespace
+
+#endif // PREPROCESSING_H
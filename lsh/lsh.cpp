@@ -21,7 +21,8 @@
 //#define VERBOSE_RANDOM
 
 LSH::LSH(const vector<vector<data_t> > &data, int K, int L,
-		 bool dataDrivenPartitions, const vector<unsigned int> &subSet) :
+		 bool dataDrivenPartitions, const vector<unsigned int> &subSet,
+		 unsigned int seed) :
 		data(data),
 		dims(data[0].size()),
 		K(K),
@@ -31,7 +32,8 @@ LSH::LSH(const vector<vector<data_t> > &data, int K, int L,
 
 		/// variety of hashes should depend solely on dims and K
 		/// (original implementation used 3 * npoints * L / 256, but has fixed bucket lengths)
-		nbuckets(GetPrime(dims * K))
+		nbuckets(GetPrime(dims * K)),
+		rngState(seed != 0 ? seed : (unsigned int)rand() + 1u)
 {
 #ifdef DEBUG
 	fprintf(stderr, "nbuckets=%d, bucketSize=%d\n", nbuckets, bucketSize);
@@ -46,7 +48,7 @@ LSH::LSH(const vector<vector<data_t> > &data, int K, int L,
 
 	/// initialize hash coefficients
 	for (int i = 0; i < max(K, L); i++)
-		hashCoeffs.push_back(rand());
+		hashCoeffs.push_back((int)(nextRandom() >> 1));
 
 	makeCuts();
 
@@ -106,8 +108,18 @@ void LSH::makeCuts()
 	}
 }
 
+unsigned int LSH::nextRandom() const {
+	/// xorshift32, state must not become zero
+	if (rngState == 0)
+		rngState = 0x9e3779b9u;
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
 int LSH::random(int max) const {
-	return min((int) ((double) rand() / RAND_MAX * (max)), max);
+	return min((int) ((double) nextRandom() / 4294967295. * (max)), max);
 }
 
 LSH::cut_t LSH::randomCut(int dim) const
@@ -131,7 +143,8 @@ LSH::cut_t LSH::randomCut(int dim) const
 		ret.dim = dim;
 		/// assuming data_t is unsigned, this should yield the maximum value
 		double maxval = (data_t) -1;
-		ret.pos = min((int) ((double) rand() / RAND_MAX * (maxval)), (int) maxval);
+		ret.pos = min((int) ((double) nextRandom() / 4294967295. * (maxval)),
+					  (int) maxval);
 	}
 
 	return ret;
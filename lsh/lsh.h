@@ -50,9 +50,11 @@ class LSH
 	typedef vector< vector<Entry> > Htable;
 
 public:
+	/// seed: random seed for partitions and hashing, 0 to draw it by rand()
 	LSH(const vector<vector<data_t> > &data, int K, int L,
 		bool dataDrivenPartitions = true,
-		const vector<unsigned int> &subSet = vector<unsigned int>());
+		const vector<unsigned int> &subSet = vector<unsigned int>(),
+		unsigned int seed = 0);
 
 	~LSH() {}
 
@@ -89,6 +91,12 @@ private:
 	vector< vector<cut_t> > partitions;
 	vector<int> hashCoeffs;
 
+	/// state of our own random generator, allows concurrent construction
+	mutable unsigned int rngState;
+
+	/// return next random number in [0;2^32)
+	unsigned int nextRandom() const;
+
 	/// return random number in [0;size)
 	int random(int max) const;
 
@@ -18,6 +18,7 @@
 
 #include <stopwatch.h>
 #include <multi_img.h>
+#include <multi_img/bandpca.h>
 #include <opencv2/highgui/highgui.hpp>
 #include <tbb/parallel_for.h>
 #include <tbb/blocked_range2d.h>
@@ -120,7 +121,9 @@ cv::Mat3f RGBDisplay::executePCA(const multi_img& src, ProgressObserver *po)
 {
 	// cover cases of lt 3 channels
 	unsigned int components = std::min((size_t)3, src.size());
-	multi_img pca3 = src.project(src.pca(components));
+	BandPCA pca;
+	pca.compute(src, components);
+	multi_img pca3 = pca.project(src);
 
 	bool cont = (!po) || po->update(.7f); // TODO: values
 	if (!cont) return cv::Mat3f();
@@ -44,6 +44,7 @@ struct Graph {
 	/* graph algorithms: spanning forest & power watersheds */
 	cv::Mat1b MSF_Prim();
 	cv::Mat1b MSF_Kruskal();
+	cv::Mat1b MSF_Boruvka();
 	cv::Mat1b PowerWatershed_q2(bool geodesic, cv::Mat1b *out_proba);
 
 
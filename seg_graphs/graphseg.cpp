@@ -97,6 +97,8 @@ cv::Mat1b GraphSeg::execute(const multi_img& input,
 			output = graph.MSF_Kruskal();
 		} else if (config.algo == PRIM) { // Prim RB tree
 			output = graph.MSF_Prim();
+		} else if (config.algo == BORUVKA) { // parallel Boruvka
+			output = graph.MSF_Boruvka();
 		}
 		watch.print("Segmentation");
 	}
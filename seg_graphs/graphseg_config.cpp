@@ -44,8 +44,9 @@ void GraphSegConfig::initBoostOptions()
 	}
 	options.add_options()
 		(key("algo"), value(&algo)->default_value(WATERSHED2),
-		                   "Algorithm to employ: KRUSKAL, PRIM or\n"
-		                   "WATERSHED2: power watersheds with q=2")
+		                   "Algorithm to employ: KRUSKAL, PRIM,\n"
+		                   "WATERSHED2: power watersheds with q=2 or\n"
+		                   "BORUVKA: parallel version of KRUSKAL")
 		(key("geodesic"), bool_switch(&geodesic)->default_value(false),
 		                   "Set to true to use geodesic reconstruction of the weights")
 		;
@@ -73,7 +74,7 @@ std::string GraphSegConfig::getString() const {
 			;
 	}
 	s << "seeds_multi=" << (multi_seed ? "true" : "false") << std::endl
-	  << "algo=" << algo << "\t# Algorithm to employ: KRUSKAL, PRIM, WATERSHED2" << std::endl
+	  << "algo=" << algo << "\t# Algorithm to employ: KRUSKAL, PRIM, WATERSHED2, BORUVKA" << std::endl
 	  << "geodesic=" << (geodesic ? "true" : "false") << std::endl  
 		;
 	s << similarity.getString();
@@ -14,9 +14,10 @@ namespace seg_graphs {
 enum algorithm {
 	KRUSKAL,
 	PRIM,
-	WATERSHED2
+	WATERSHED2,
+	BORUVKA
 };
-#define seg_graphs_algorithmString {"KRUSKAL", "PRIM", "WATERSHED2"}
+#define seg_graphs_algorithmString {"KRUSKAL", "PRIM", "WATERSHED2", "BORUVKA"}
 
 /**
  * Configuration parameters for the graph cut / power watershed segmentation
@@ -162,17 +162,9 @@ void TriEdges(int ** index_edges,  /* array of vertices composing edges */
 // sort the array of vertices composing edges by ascending node index
 // and fill an indicator of same edges presence
 	int i, j;
-	TriRapideStochastique(index_edges[0], index_edges[1], 0, M - 1);
-	i = 0;
-	while (i < M) {
-		j = i;
-		while ((i < M - 1) && (index_edges[0][i] == index_edges[0][i + 1]))
-			i++;
-		if (i != j)
-			TriRapideStochastique(&index_edges[1][j], &index_edges[0][j], 0,
-								  i - j);
-		i++;
-	}
+	// lexicographic order by stable sorting on second, then first node
+	radixSort(index_edges[1], index_edges[0], M);
+	radixSort(index_edges[0], index_edges[1], M);
 	for (i = 0; i < M; i++) {
 		j = 0;
 		while ((i + j < M - 1) &&
@@ -76,7 +76,11 @@
 
 #include "sorting.h"
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 #include <algorithm>
+#include <cstring>
 #include <vector>
 
 namespace seg_graphs {
@@ -300,30 +304,156 @@ bool Score::operator<(const Score& score) const
 }
 
 
+/* number of elements per chunk of the parallel radix sort */
+static const int RADIX_CHUNK = 1 << 16;
+/* below this size, std::stable_sort is faster */
+static const int RADIX_MIN = 256;
+
+/* stable counting sort of (A, I) by the 8 bit digit at shift into (tA, tI)
+ * chunks are counted in parallel, then scattered in parallel to their own
+ * offsets, which keeps equal keys in order */
+static bool radixPass(const uint32_t *A, const int *I, uint32_t *tA, int *tI,
+					  int M, int shift)
+{
+	const int nchunks = (M + RADIX_CHUNK - 1) / RADIX_CHUNK;
+	std::vector<int> count(nchunks * 256, 0);
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, nchunks, 1),
+					  [&](const tbb::blocked_range<int> &r) {
+		for (int c = r.begin(); c != r.end(); ++c) {
+			int *cnt = &count[c * 256];
+			const int end = std::min(M, (c + 1) * RADIX_CHUNK);
+			for (int k = c * RADIX_CHUNK; k < end; ++k)
+				cnt[(A[k] >> shift) & 0xff]++;
+		}
+	});
+
+	// all keys share this digit, nothing to do
+	for (int d = 0; d < 256; ++d) {
+		int total = 0;
+		for (int c = 0; c < nchunks; ++c)
+			total += count[c * 256 + d];
+		if (total == M)
+			return false;
+	}
+
+	/* offsets: digit major, chunk minor */
+	int sum = 0;
+	for (int d = 0; d < 256; ++d) {
+		for (int c = 0; c < nchunks; ++c) {
+			int &cnt = count[c * 256 + d];
+			int tmp = cnt;
+			cnt = sum;
+			sum += tmp;
+		}
+	}
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, nchunks, 1),
+					  [&](const tbb::blocked_range<int> &r) {
+		for (int c = r.begin(); c != r.end(); ++c) {
+			int *pos = &count[c * 256];
+			const int end = std::min(M, (c + 1) * RADIX_CHUNK);
+			for (int k = c * RADIX_CHUNK; k < end; ++k) {
+				int p = pos[(A[k] >> shift) & 0xff]++;
+				tA[p] = A[k];
+				tI[p] = I[k];
+			}
+		}
+	});
+	return true;
+}
+
+struct RadixEntry {
+	uint32_t key;
+	int index;
+	bool operator<(const RadixEntry &o) const { return key < o.key; }
+};
+
+/* =============================================================== */
+void radixSort(uint32_t *A, int *I, int M)
+/* =============================================================== */
+{
+	if (M < 2)
+		return;
+
+	if (M < RADIX_MIN) {
+		std::vector<RadixEntry> data(M);
+		for (int k = 0; k < M; k++) {
+			RadixEntry entry = { A[k], I[k] };
+			data[k] = entry;
+		}
+		std::stable_sort(data.begin(), data.end());
+		for (int k = 0; k < M; k++) {
+			A[k] = data[k].key;
+			I[k] = data[k].index;
+		}
+		return;
+	}
+
+	std::vector<uint32_t> tmpA(M);
+	std::vector<int> tmpI(M);
+	uint32_t *srcA = A, *dstA = &tmpA[0];
+	int *srcI = I, *dstI = &tmpI[0];
+	for (int shift = 0; shift < 32; shift += 8) {
+		if (radixPass(srcA, srcI, dstA, dstI, M, shift)) {
+			std::swap(srcA, dstA);
+			std::swap(srcI, dstI);
+		}
+	}
+
+	// result ended up in the temporary arrays
+	if (srcA != A) {
+		memcpy(A, srcA, M * sizeof(uint32_t));
+		memcpy(I, srcI, M * sizeof(int));
+	}
+}
+
+/* =============================================================== */
+void radixSort(int *A, int *I, int M)
+/* =============================================================== */
+{
+	// flipping the sign bit maps signed to unsigned order
+	uint32_t *U = reinterpret_cast<uint32_t*>(A);
+	for (int k = 0; k < M; k++)
+		U[k] ^= 0x80000000u;
+	radixSort(U, I, M);
+	for (int k = 0; k < M; k++)
+		U[k] ^= 0x80000000u;
+}
+
+/* =============================================================== */
+uint32_t floatKey(float f)
+/* =============================================================== */
+{
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	// positive: flip sign bit, negative: flip all bits
+	return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
 /* =============================================================== */
 void sortRange(float * F, int * Es, int M, bool reverse)
 /* =============================================================== */
 /* sort values of array F ascending (default), Es stores the edge nr. */
 {
-	std::vector<Score> data(M);
-
-	for(int k = 0; k < M; k++) {
-		Score entry = {F[k], Es[k]};
-		data[k] = entry;
+	if (M < 2)
+		return;
+
+	std::vector<uint32_t> keys(M);
+	std::vector<int> order(M);
+	for (int k = 0; k < M; k++) {
+		// inverted keys give descending order, still stable
+		keys[k] = (reverse ? ~floatKey(F[k]) : floatKey(F[k]));
+		order[k] = k;
 	}
 
-	sort(data.begin(), data.end());
+	radixSort(&keys[0], &order[0], M);
 
-	if (reverse) {
-		for (int k=0; k<M; k++) {
-			F[k] = data[M - k - 1].value;
-			Es[k] = data[M - k - 1].index;
-		}
-	} else {
-		for (int k=0; k<M; k++) {
-			F[k] = data[k].value;
-			Es[k] = data[k].index;
-		}
+	std::vector<float> values(F, F + M);
+	std::vector<int> indices(Es, Es + M);
+	for (int k = 0; k < M; k++) {
+		F[k] = values[order[k]];
+		Es[k] = indices[order[k]];
 	}
 }
 
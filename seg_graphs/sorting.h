@@ -14,8 +14,21 @@ struct Score
 	bool operator<(const Score& score) const;
 };
 
+/* sort values of F ascending (default) or descending, Es is permuted along
+ * stable and parallel, see radixSort() */
 void sortRange(float *F, int *Es, int M, bool reverse = false);
 
+/* stable LSD radix sort of A ascending, I is permuted along
+ * runs in O(M) with one parallel counting pass per 8 bit digit; digits that
+ * are the same for all keys are skipped */
+void radixSort(unsigned int *A, int *I, int M);
+
+/* same for signed keys */
+void radixSort(int *A, int *I, int M);
+
+/* order preserving mapping of float values to unsigned keys */
+unsigned int floatKey(float f);
+
 }
 
 #endif
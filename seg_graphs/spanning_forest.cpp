@@ -59,6 +59,9 @@
 #include "graph_alg.h"
 #include "sorting.h"
 #include "graph.h"
+#include <tbb/atomic.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <limits>
 #include <set>
 #include <stack>
@@ -173,15 +176,12 @@ cv::Mat1b Graph::MSF_Kruskal() {
 	// create indices sorted by edge weight, descending
 	int *Es = new int[M];
 	{
-		std::vector<Score> sorter(M);
+		std::vector<float> weights(M);
 		for (k = 0; k < M; k++) {
-			Score entry = { edges[k].weight, k };
-			sorter[k] = entry;
-		}
-		std::sort(sorter.begin(), sorter.end());
-		for (k = 0; k < M; k++) {
-			Es[k] = sorter[M - k - 1].index;
+			weights[k] = edges[k].weight;
+			Es[k] = k;
 		}
+		sortRange(&weights[0], Es, M, true);
 	}
 
 	int nb_arete = 0;
@@ -263,6 +263,136 @@ cv::Mat1b Graph::MSF_Kruskal() {
 	return ret;
 }
 
+/* edge order of MSF_Kruskal: descending weight, ties by edge index */
+struct BoruvkaOrder {
+	BoruvkaOrder(const std::vector<unsigned int> &keys) : keys(keys) {}
+	bool operator()(int e, int f) const {
+		return keys[e] > keys[f] || (keys[e] == keys[f] && e < f);
+	}
+	const std::vector<unsigned int> &keys;
+};
+
+/*=====================================================================*/
+cv::Mat1b Graph::MSF_Boruvka() {
+/*=====================================================================*/
+/* returns the segmentation of MSF_Kruskal, computed by parallel Boruvka.
+   Kruskal's seeded forest is the maximum spanning tree of the graph with an
+   additional root node, connected to all seeds by edges of infinite weight.
+   With the strict edge order of Kruskal, this tree is unique, so Boruvka
+   finds the same one. The root is node N, seeds start in its component. */
+	const int N = width * height; /* number of vertices */
+	const int M = edges.size();   /* number of edges */
+
+	std::vector<unsigned int> keys(M);
+	tbb::parallel_for(0, M, [&](int e) {
+		keys[e] = floatKey(edges[e].weight);
+	});
+	BoruvkaOrder better(keys);
+
+	// component of each node, components are identified by a node
+	std::vector<int> comp(N + 1), next(N + 1), jumped(N + 1);
+	for (int i = 0; i <= N; i++)
+		comp[i] = i;
+	for (size_t i = 0; i < seeds.size(); i++)
+		comp[seeds[i].first] = N;
+
+	std::vector<tbb::atomic<int> > best(N + 1);
+	std::vector<unsigned char> selected(M, 0);
+
+	while (true) {
+		/* 1. heaviest outgoing edge of each component */
+		tbb::parallel_for(0, N + 1, [&](int c) { best[c] = -1; });
+		tbb::parallel_for(tbb::blocked_range<int>(0, M),
+						  [&](const tbb::blocked_range<int> &r) {
+			for (int e = r.begin(); e != r.end(); ++e) {
+				int c[2] = { comp[edges[e].nodes[0]],
+							 comp[edges[e].nodes[1]] };
+				if (c[0] == c[1])
+					continue;
+				for (int k = 0; k < 2; ++k) {
+					int cur = best[c[k]];
+					while (cur == -1 || better(e, cur)) {
+						if (best[c[k]].compare_and_swap(e, cur) == cur)
+							break;
+						cur = best[c[k]];
+					}
+				}
+			}
+		});
+
+		/* 2. hook components along their edges. With a strict order, only
+		   pairs of components choose each other, the smaller becomes root */
+		tbb::atomic<int> hooked;
+		hooked = 0;
+		tbb::parallel_for(0, N + 1, [&](int c) {
+			int e = best[c];
+			if (e == -1) {
+				next[c] = c;
+				return;
+			}
+			int d = comp[edges[e].nodes[0]];
+			if (d == c)
+				d = comp[edges[e].nodes[1]];
+			if (best[d] == e && c < d) {
+				next[c] = c;
+			} else {
+				// each edge is hooked along by one component only
+				next[c] = d;
+				selected[e] = 1;
+			}
+			hooked++;
+		});
+		if (hooked == 0)
+			break;
+
+		/* 3. pointer jumping to the new roots */
+		bool changed = true;
+		while (changed) {
+			tbb::atomic<int> jumps;
+			jumps = 0;
+			tbb::parallel_for(0, N + 1, [&](int c) {
+				jumped[c] = next[next[c]];
+				if (jumped[c] != next[c])
+					jumps++;
+			});
+			next.swap(jumped);
+			changed = (jumps > 0);
+		}
+		tbb::parallel_for(0, N + 1, [&](int i) { comp[i] = next[comp[i]]; });
+	}
+
+	/* removing the root splits the tree into one tree per seed */
+	int * Rnk = (int*)calloc(N, sizeof(int));
+	int * Fth = (int*)malloc(N * sizeof(int));
+	if (Rnk == NULL || Fth == NULL) {
+		fprintf(stderr, "MSF_Boruvka() : malloc failed\n"); exit(0);
+	}
+	for (int k = 0; k < N; k++)
+		Fth[k] = k;
+	for (int e = 0; e < M; e++) {
+		if (selected[e]) {
+			int x = element_find(edges[e].nodes[0], Fth);
+			int y = element_find(edges[e].nodes[1], Fth);
+			if (x != y)
+				element_link(x, y, Rnk, Fth);
+		}
+	}
+
+	std::vector<unsigned char> label(N, 0);
+	for (size_t i = 0; i < seeds.size(); i++)
+		label[element_find(seeds[i].first, Fth)] = seeds[i].second;
+
+	cv::Mat1b ret(height, width);
+	uchar *out = ret.ptr<uchar>();
+	tbb::parallel_for(0, N, [&](int i) {
+		out[i] = label[element_find(i, Fth)] - 1;
+	});
+
+	free(Rnk);
+	free(Fth);
+	return ret;
+}
+
 /*========================================================================================================*/
 void memory_allocation_PW(bool ** indic_E,     /* indicator for edges */
 						  bool ** indic_P,     /* indicator for edges */
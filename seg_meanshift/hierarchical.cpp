@@ -0,0 +1,150 @@
+#include "mfams.h"
+
+#include <tbb/parallel_for.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace seg_meanshift {
+
+void FAMS::importPoints(const FAMS &source,
+						const std::vector<unsigned int> &subset)
+{
+	// the subset is treated as a single row of points
+	w_ = (unsigned int)subset.size(); h_ = 1;
+	n_ = w_;
+	d_ = source.d_;
+
+	minVal_ = source.minVal_;
+	maxVal_ = source.maxVal_;
+
+	pointCounts.clear();
+	pixelPoints.clear();
+	dataholder.resize(subset.size());
+	for (size_t i = 0; i < subset.size(); ++i)
+		dataholder[i] = source.dataholder[subset[i]];
+
+	// link points to their data
+	datapoints.resize(dataholder.size());
+	for (size_t i = 0; i < dataholder.size(); ++i) {
+		datapoints[i].data = &dataholder[i];
+	}
+}
+
+void FAMS::assignModes()
+{
+	// points referencing the mode vectors, for DistL1()
+	std::vector<Point> centers(modes.size());
+	for (size_t m = 0; m < modes.size(); ++m)
+		centers[m].data = &modes[m].data;
+
+	prunedIndex.resize(n_);
+	tbb::parallel_for(size_t(0), (size_t)n_, [&](size_t i) {
+		unsigned int best = std::numeric_limits<unsigned int>::max();
+		for (size_t m = 0; m < centers.size(); ++m) {
+			unsigned int dist = DistL1(datapoints[i], centers[m]);
+			if (dist < best) {
+				best = dist;
+				prunedIndex[i] = (int)m;
+			}
+		}
+	});
+}
+
+bool FAMS::hierarchicalFAMS(int step)
+{
+	// spatial layout of the points is needed
+	assert(n_ == w_ * h_ && pixelPoints.empty());
+	bgLog("Hierarchical FAMS, coarse level with every %d. pixel\n", step);
+
+	/* coarse level: mean shift on a spatially subsampled point set */
+	std::vector<unsigned int> subset;
+	for (unsigned int y = 0; y < h_; y += step)
+		for (unsigned int x = 0; x < w_; x += step)
+			subset.push_back(y * w_ + x);
+
+	FAMS coarse(config, po);
+	coarse.importPoints(*this, subset);
+	if (!coarse.prepareFAMS())
+		return false;
+	coarse.selectStartPoints(0., 1);
+	if (!coarse.finishFAMS())
+		return false;
+	coarse.pruneModes();
+	if (coarse.prunedModes.empty())
+		return false;
+
+	/* seeds: pruned coarse modes, window is the mean of their members */
+	size_t nmodes = coarse.prunedModes.size();
+	std::vector<double> windows(nmodes, 0.);
+	std::vector<int> members(nmodes, 0);
+	double allwindows = 0.;
+	for (size_t i = 0; i < coarse.modes.size(); ++i) {
+		int m = coarse.prunedIndex[i];
+		windows[m] += coarse.modes[i].window;
+		members[m]++;
+		allwindows += coarse.modes[i].window;
+	}
+	allwindows /= coarse.modes.size();
+
+	modes.resize(nmodes);
+	for (size_t m = 0; m < nmodes; ++m) {
+		modes[m].data = coarse.prunedModes[m];
+		modes[m].window = (unsigned int)(members[m] > 0
+										 ? windows[m] / members[m]
+										 : allwindows);
+	}
+
+	/* full level: points inherit the bandwidth of their closest mode */
+	bgLog(" refine %d modes at full resolution\n", (int)nmodes);
+	assignModes();
+	for (unsigned int i = 0; i < n_; ++i) {
+		Point &p = datapoints[i];
+		p.window = std::max(modes[prunedIndex[i]].window, 1u);
+		p.weightdp2 = pow(FAMS_FLOAT_SHIFT / p.window, (d_ + 2) * FAMS_ALPHA);
+	}
+
+	/* trajectories only start at the modes, bounded by the coarse level */
+	tbb::parallel_for(size_t(0), nmodes, [&](size_t m) {
+		std::vector<unsigned short> oldMean(d_, 0), crtMean = modes[m].data;
+		for (int iter = 0; oldMean != crtMean && iter < FAMS_MAXITER; ++iter) {
+			oldMean = crtMean;
+			unsigned int newWindow =
+					DoMSAdaptiveIteration(NULL, oldMean, crtMean);
+			if (!newWindow)
+				break;
+			modes[m].window = newWindow;
+		}
+		modes[m].data = crtMean;
+	});
+	if (!progressUpdate(100.f))
+		return false;
+
+	/* drop modes that converged onto an earlier one */
+	std::vector<Mode> kept;
+	for (size_t m = 0; m < modes.size(); ++m) {
+		bool duplicate = false;
+		for (size_t k = 0; k < kept.size() && !duplicate; ++k) {
+			double dist;
+			Point p;
+			p.data = &kept[k].data;
+			duplicate = DistL1Data(modes[m].data, p,
+								   modes[m].window >> FAMS_PRUNE_HDIV, dist);
+		}
+		if (!duplicate)
+			kept.push_back(modes[m]);
+	}
+	modes.swap(kept);
+
+	/* final nearest-mode assignment */
+	assignModes();
+	prunedModes.resize(modes.size());
+	for (size_t m = 0; m < modes.size(); ++m)
+		prunedModes[m] = modes[m].data;
+
+	bgLog("done (%d modes).\n", (int)modes.size());
+	return true;
+}
+
+}
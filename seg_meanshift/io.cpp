@@ -8,6 +8,8 @@
 #include <fstream>
 #include "mfams.h"
 
+#include <boost/unordered_map.hpp>
+
 using namespace std;
 
 namespace seg_meanshift {
@@ -74,7 +76,7 @@ bool FAMS::loadPoints(char* filename) {
 	return true;
 }
 
-bool FAMS::importPoints(const multi_img& img) {
+bool FAMS::importPoints(const multi_img& img, bool unique) {
 	bgLog("Import data points from multispectral image... ");
 
 	// w_ and h_ are only used for result output (i.e. in io.cpp)
@@ -85,8 +87,34 @@ bool FAMS::importPoints(const multi_img& img) {
 	minVal_ = img.minval;
 	maxVal_ = img.maxval;
 
-	// let multi_img do the hard work
-	dataholder = img.export_ushort(true);
+	pointCounts.clear();
+	pixelPoints.clear();
+	if (!unique) {
+		// let multi_img do the hard work
+		dataholder = img.export_ushort(true);
+	} else {
+		/* merge identical quantized spectra (common in saturated or dark
+		   regions of 8/12 bit data), keep count for weighting */
+		std::vector<std::vector<unsigned short> > all = img.export_ushort(true);
+		typedef boost::unordered_map<std::vector<unsigned short>, unsigned int>
+				PointMap;
+		PointMap index;
+		dataholder.clear();
+		pixelPoints.resize(all.size());
+		for (size_t i = 0; i < all.size(); ++i) {
+			std::pair<PointMap::iterator, bool> ins =
+					index.insert(std::make_pair(all[i], (unsigned int)dataholder.size()));
+			if (ins.second) {
+				dataholder.push_back(std::vector<unsigned short>());
+				dataholder.back().swap(all[i]);
+				pointCounts.push_back(0);
+			}
+			pointCounts[ins.first->second]++;
+			pixelPoints[i] = ins.first->second;
+		}
+		n_ = (unsigned int)dataholder.size();
+		bgLog("%u unique of %u points... ", n_, w_ * h_);
+	}
 
 	// link points to their data
 	datapoints.resize(dataholder.size());
@@ -99,13 +127,14 @@ bool FAMS::importPoints(const multi_img& img) {
 
 cv::Mat1s FAMS::segmentImage() const {
 	// mean shift was run on _all_ points
-	assert(w_ * h_ == prunedIndex.size());
+	assert(n_ == prunedIndex.size());
+	assert(w_ * h_ == samples());
 	cv::Mat1s ret(h_, w_);
 	
 	cv::Mat1s::iterator it = ret.begin();
 	for (int i = 0; it != ret.end(); ++it, ++i) {
-		// keep clear of zero
-		*it = prunedIndex[i] + 1;
+		// keep clear of zero, map pixel to its (merged) point
+		*it = prunedIndex[pixelPoints.empty() ? i : pixelPoints[i]] + 1;
 	}
 	
 	return ret;
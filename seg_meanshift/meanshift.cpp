@@ -27,7 +27,7 @@ KLResult MeanShift::findKL(const multi_img& input, ProgressObserver *po)
 {
 	// load points
 	FAMS cfams(config, po);
-	cfams.importPoints(input);
+	cfams.importPoints(input, config.unique);
 	return cfams.FindKL();
 }
 
@@ -51,7 +51,14 @@ MeanShift::Result MeanShift::execute(const multi_img& input,
 	// HACK it's a shame
 	cfams.spsizes = spsizes;
 
-	cfams.importPoints(input);
+	/* merging identical spectra requires a result for every point, and
+	   bandwidths or sizes that are not given per input point. Same for the
+	   coarse-to-fine approach, which also needs the spatial layout. */
+	bool hierarchical = (config.coarseStep > 1 && config.starting == ALL
+						 && !bandwidths && spsizes.empty());
+	bool unique = (config.unique && config.starting == ALL
+				   && !bandwidths && spsizes.empty() && !hierarchical);
+	cfams.importPoints(input, unique);
 
 #ifdef WITH_SEG_FELZENSZWALB
 	// superpixel setup
@@ -76,44 +83,52 @@ MeanShift::Result MeanShift::execute(const multi_img& input,
 	}
 #endif
 
-	// prepare MS run (adaptive bandwidths)
-	bool success = cfams.prepareFAMS(bandwidths);
-	if (!success)
-		return Result();
-
-	// define starting points
-	/* done after preparation such that superpixel can rely on bandwidths */
-	switch (config.starting) {
-	case JUMP:
-		cfams.selectStartPoints(0., config.jump);
-		break;
-	case PERCENT:
-		cfams.selectStartPoints(config.percent, 1);
-		break;
+	bool success;
+	if (hierarchical) {
+		// replaces preparation, mean shift and pruning below
+		success = cfams.hierarchicalFAMS(config.coarseStep);
+		if (!success)
+			return Result();
+	} else {
+		// prepare MS run (adaptive bandwidths)
+		success = cfams.prepareFAMS(bandwidths);
+		if (!success)
+			return Result();
+
+		// define starting points
+		/* done after preparation such that superpixel can rely on bandwidths */
+		switch (config.starting) {
+		case JUMP:
+			cfams.selectStartPoints(0., config.jump);
+			break;
+		case PERCENT:
+			cfams.selectStartPoints(config.percent, 1);
+			break;
 #ifdef WITH_SEG_FELZENSZWALB
-	case SUPERPIXEL:
-		sp_points = prepare_sp_points(cfams, sp_map);
-		cfams.importStartPoints(sp_points);
-		break;
+		case SUPERPIXEL:
+			sp_points = prepare_sp_points(cfams, sp_map);
+			cfams.importStartPoints(sp_points);
+			break;
 #endif
-	default:
-		cfams.selectStartPoints(0., 1);
-	}
+		default:
+			cfams.selectStartPoints(0., 1);
+		}
 
-	// perform mean shift
-	success = cfams.finishFAMS();
+		// perform mean shift
+		success = cfams.finishFAMS();
 #ifdef WITH_SEG_FELZENSZWALB
-/*	if (config.starting == SUPERPIXEL) {
-		cfams.DbgSavePoints(config.output_directory + "/sp-points-img",
-							sp_points, input.meta);
-	}*/
-	cleanup_sp_points(sp_points);
+/*		if (config.starting == SUPERPIXEL) {
+			cfams.DbgSavePoints(config.output_directory + "/sp-points-img",
+								sp_points, input.meta);
+		}*/
+		cleanup_sp_points(sp_points);
 #endif
-	if (!success)
-		return Result();
+		if (!success)
+			return Result();
 
-	// postprocess: prune modes
-	cfams.pruneModes();
+		// postprocess: prune modes
+		cfams.pruneModes();
+	}
 
 	if (config.verbosity > 1) {
 		// save the data
@@ -44,6 +44,8 @@ MeanShiftConfig::MeanShiftConfig(const std::string& p)
 	Kjump = 1;
 	epsilon = 0.05f;
 	pruneMinN = 50;
+	unique = false;
+	coarseStep = 0;
 
 	output_directory = "/tmp";
 	findKL = false;
@@ -86,6 +88,8 @@ std::string MeanShiftConfig::getString() const {
 	  << "initjump=" << jump << std::endl
 	  << "initpercent=" << percent << std::endl
 	  << "bandwidth=" << bandwidth << std::endl
+	  << "unique=" << (unique ? "true" : "false") << std::endl
+	  << "coarsestep=" << coarseStep << std::endl
 		;
 	return s.str();
 }
@@ -145,6 +149,11 @@ void MeanShiftConfig::initBoostOptions()
 			 "randomly select given percentage of points")
 			(key("bandwidth"), value(&bandwidth)->default_value(bandwidth),
 			 "use fixed bandwidth*dimensionality for mean shift window (else: adaptive)")
+			(key("unique"), bool_switch(&unique)->default_value(unique),
+			 "merge identical spectra into weighted points (initmethod ALL)")
+			(key("coarsestep"), value(&coarseStep)->default_value(coarseStep),
+			 "run mean shift on every Xth pixel per direction first, then refine "
+			 "the modes on all pixels (initmethod ALL, 0 to disable)")
 
 	;
 #ifdef WITH_SEG_FELZENSZWALB
@@ -78,6 +78,12 @@ public:
 	int Kmin, Kjump;
 	float epsilon;
 
+	/// merge identical spectra into weighted points (ALL sampling only)
+	bool unique;
+
+	/// coarse-to-fine: run on every Xth pixel first (ALL sampling, 0: off)
+	int coarseStep;
+
 	/// random seed (0 means time-based)
 	int seed;
 
@@ -158,8 +158,11 @@ MeanShiftShell::execute(std::map<std::string, boost::any> &input,
 				<< "\tL = " << config.L << std::endl;
 		}
 		res.insertInto(output);
-		return output;
-	} else {
+		// continue with segmentation, using found K, L if any
+		if (res.isState(KLState::Aborted))
+			return output;
+	}
+	{
 		MeanShift::Result res = ms.execute(
 #ifdef WITH_SEG_FELZENSZWALB
 				  (config.sp_withGrad ? *inputgrad : *inputimg),
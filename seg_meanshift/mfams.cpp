@@ -80,7 +80,7 @@ void FAMS::importStartPoints(std::vector<Point> &points)
 
 void FAMS::ComputePilotPoint::operator()(const tbb::blocked_range<int> &r)
 {
-	const int thresh = (int)(fams.config.k * std::sqrt((float)fams.n_));
+	const int thresh = (int)(fams.config.k * std::sqrt((float)fams.samples()));
 	const int win_j = 10, max_win = 7000;
 	const int mwpwj = max_win / win_j;
 	unsigned int nn;
@@ -100,7 +100,7 @@ void FAMS::ComputePilotPoint::operator()(const tbb::blocked_range<int> &r)
 			for (unsigned int i = 0; i < fams.n_; i++) {
 				nn = fams.DistL1(fams.datapoints[j], fams.datapoints[i]) / wjd;
 				if (nn < mwpwj)
-					numns[nn]++;
+					numns[nn] += fams.multiplicity(i);
 			}
 		} else {
 			lsh->query(j);
@@ -109,7 +109,7 @@ void FAMS::ComputePilotPoint::operator()(const tbb::blocked_range<int> &r)
 				nn = fams.DistL1(fams.datapoints[j], fams.datapoints[lshResult[i]])
 						/ wjd;
 				if (nn < mwpwj)
-					numns[nn]++;
+					numns[nn] += fams.multiplicity(lshResult[i]);
 			}
 		}
 
@@ -169,20 +169,21 @@ bool FAMS::ComputePilot(vector<double> *weights) {
 
 // compute real bandwiths for selected points
 void FAMS::ComputeRealBandwidths(unsigned int h) {
-	const int thresh = (int)(config.k * std::sqrt((float)n_));
+	const int thresh = (int)(config.k * std::sqrt((float)samples()));
 	const int    win_j = 10, max_win = 7000;
-	unsigned int nn;
 	unsigned int wjd;
 	wjd =        (unsigned int)(win_j * d_);
 	if (h == 0) {
-		for (size_t j = 0; j < startPoints.size(); j++) {
+		// points are independent, each one scans all data points
+		tbb::parallel_for(size_t(0), startPoints.size(), [&](size_t j) {
+			unsigned int nn;
 			int numn = 0;
 			int numns[max_win / win_j];
 			memset(numns, 0, sizeof(numns));
 			for (unsigned int i = 0; i < n_; i++) {
 				nn = DistL1(*startPoints[j], datapoints[i]) / wjd;
 				if (nn < max_win / win_j)
-					numns[nn]++;
+					numns[nn] += multiplicity(i);
 			}
 			for (nn = 0; nn < max_win / win_j; nn++) {
 				numn += numns[nn];
@@ -191,7 +192,7 @@ void FAMS::ComputeRealBandwidths(unsigned int h) {
 				}
 			}
 			startPoints[j]->window = (nn + 1) * win_j;
-		}
+		});
 	} else{
 		for (size_t j = 0; j < startPoints.size(); j++) {
 			startPoints[j]->window = h;
@@ -200,8 +201,8 @@ void FAMS::ComputeRealBandwidths(unsigned int h) {
 }
 
 // compute the pilot h_i's for the data points
-void FAMS::ComputeScores(float* scores, LSHReader &lsh, int L) {
-	const int thresh = (int)(config.k * std::sqrt((float)n_));
+void FAMS::ComputeScores(float* scores, LSHReader &lsh, int L) const {
+	const int thresh = (int)(config.k * std::sqrt((float)samples()));
 	const int    win_j = 10, max_win = 7000;
 	unsigned int nn;
 	unsigned int wjd = (unsigned int)(win_j * d_);
@@ -218,7 +219,7 @@ void FAMS::ComputeScores(float* scores, LSHReader &lsh, int L) {
 		for (int i = 0; i < (int) lshResult.size(); i++) {
 			nn = DistL1(*startPoints[j], datapoints[lshResult[i]]) / wjd;
 			if (nn < max_win / win_j)
-				numns[nn]++;
+				numns[nn] += multiplicity(lshResult[i]);
 
 			if (i == (num_l[nl] - 1)) {
 				// partition boundary
@@ -408,7 +409,7 @@ KLResult FAMS::FindKL() {
 	ComputeRealBandwidths(hWidth);
 
 	// start finding the correct l for each k
-	// scores for 10 trials runs per L
+	// scores for 10 trials runs per L, each trial has Lmax entries
 	std::vector<float> scores(FAMS_FKL_TIMES * Lmax);
 	int   Lcrt, Kcrt;
 
@@ -417,13 +418,19 @@ KLResult FAMS::FindKL() {
 	std::vector<int> KBest(Kmax); /// contains the actual value of K for each tested K
 
 	int ntimes, is;
+	/* trials run in parallel. Their seeds are drawn beforehand, so results
+	   only depend on the random state, not on scheduling. */
+	unsigned int seeds[FAMS_FKL_TIMES];
 	Lcrt = Lmax;
 	bgLog(" find valid pairs.. ");
 	/// for each K...
 	for (Kcrt = Kmax, nBest = 0; Kcrt >= Kmin; Kcrt -= Kjump, nBest++) {
 		// do iterations for current K and L = 1...Lcrt
 		for (ntimes = 0; ntimes < FAMS_FKL_TIMES; ntimes++)
-			DoFindKLIteration(Kcrt, Lcrt, &scores[ntimes * Lcrt]);
+			seeds[ntimes] = (unsigned int)rand() + 1u;
+		tbb::parallel_for(0, FAMS_FKL_TIMES, [&](int t) {
+			DoFindKLIteration(Kcrt, Lcrt, &scores[t * Lmax], seeds[t]);
+		});
 
 		// get best L for current k
 		KBest[nBest] = Kcrt;
@@ -431,8 +438,8 @@ KLResult FAMS::FindKL() {
 		for (is = 0; is < Lcrt; is++) {
 			// find worst error with this L
 			for (ntimes = 1; ntimes < FAMS_FKL_TIMES; ntimes++) {
-				if (scores[is] < scores[ntimes * Lcrt + is])
-					scores[is] = scores[ntimes * Lcrt + is];
+				if (scores[is] < scores[ntimes * Lmax + is])
+					scores[is] = scores[ntimes * Lmax + is];
 			}
 			if (scores[is] < epsilon) {
 				LBest[nBest] = is + 1;
@@ -468,16 +475,20 @@ KLResult FAMS::FindKL() {
 		if (LBest[i] <= 0)
 			continue;
 		for (ntimes = 0; ntimes < FAMS_FKL_TIMES; ntimes++)
-			run_times[ntimes] =
-				DoFindKLIteration(KBest[i], LBest[i], &scores[ntimes * Lcrt]);
+			seeds[ntimes] = (unsigned int)rand() + 1u;
+		// all pairs are timed under the same parallel load
+		tbb::parallel_for(0, FAMS_FKL_TIMES, [&](int t) {
+			run_times[t] = DoFindKLIteration(KBest[i], LBest[i],
+											 &scores[t * Lmax], seeds[t]);
+		});
 		sort(&run_times[0], &run_times[FAMS_FKL_TIMES]);
 		// compare with median
 		if ((timeBest == -1) || (timeBest > run_times[FAMS_FKL_TIMES / 2])) {
 			iBest    = i;
 			timeBest = run_times[FAMS_FKL_TIMES / 2];
 		}
-		bgLog("  K=%d L=%d time: %g\n", KBest[i], LBest[i],
-			  run_times[FAMS_FKL_TIMES / 2]);
+		bgLog("  K=%d L=%d time: %lld\n", KBest[i], LBest[i],
+			  (long long)run_times[FAMS_FKL_TIMES / 2]);
 	}
 	bgLog("done\n");
 
@@ -490,8 +501,8 @@ KLResult FAMS::FindKL() {
 }
 
 
-int64 FAMS::DoFindKLIteration(int K, int L, float* scores) {
-	LSH lsh(dataholder, d_, K, L);
+int64 FAMS::DoFindKLIteration(int K, int L, float* scores, unsigned int seed) {
+	LSH lsh(dataholder, K, L, true, std::vector<unsigned int>(), seed);
 	LSHReader lshreader(lsh);
 
 	// Compute Scores
@@ -506,7 +517,7 @@ bool FAMS::prepareFAMS(vector<double> *bandwidths) {
 
 	if (config.use_LSH) {
 		bgLog("Running FAMS with K=%d L=%d\n", config.K, config.L);
-		lsh_ = new LSH(dataholder, d_, config.K, config.L);
+		lsh_ = new LSH(dataholder, config.K, config.L);
 	} else {
 		bgLog("Running FAMS without LSH (try --useLSH)\n");
 	}
@@ -548,6 +559,12 @@ bool FAMS::prepareFAMS(vector<double> *bandwidths) {
 		}
 	}
 
+	// merged points stand for all their duplicates
+	if (!pointCounts.empty()) {
+		for (unsigned int i = 0; i < n_; i++)
+			datapoints[i].weightdp2 *= pointCounts[i];
+	}
+
 	if (!cont) {
 		delete lsh_;
 		lsh_ = NULL;
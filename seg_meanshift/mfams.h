@@ -83,6 +83,7 @@ public:
 	// used for mode pruning, defined in mode_pruning.cpp
 	struct MergedMode {
 		MergedMode() {}
+		// m: weight of the mode (number of points it stands for)
 		MergedMode(const FAMS::Mode &d, int m, int spm);
 
 		// compare sizes for DESCENDING sort
@@ -91,7 +92,7 @@ public:
 
 		std::vector<unsigned short> normalized() const;
 		double distTo(const FAMS::Mode &m) const;
-		void add(const FAMS::Mode &m, int sp);
+		void add(const FAMS::Mode &m, int sp, int count = 1);
 		bool invalidateIfSmall(int smallest);
 
 		std::vector<float> data;
@@ -137,7 +138,12 @@ public:
 	const std::vector<int>& getModePerPixel() const { return prunedIndex; }
 
 	bool loadPoints(char* filename);
-	bool importPoints(const multi_img& img);
+	/** if unique is set, identical spectra are merged into one point that
+	 *  is weighted by its multiplicity. Use only with ALL starting points.
+	 */
+	bool importPoints(const multi_img& img, bool unique = false);
+	// import subset of the points of another instance, see hierarchical.cpp
+	void importPoints(const FAMS &source, const std::vector<unsigned int> &subset);
 	void selectStartPoints(double percent, int jump);
 	void importStartPoints(std::vector<Point> &points);
 
@@ -148,6 +154,14 @@ public:
 	bool finishFAMS();
 	void pruneModes();
 
+	/** coarse-to-fine alternative to prepareFAMS(), finishFAMS() and
+	 *  pruneModes() with all points as starting points. Mean shift runs on
+	 *  every step-th pixel in both directions, the pruned modes are then
+	 *  refined on all points and each point is assigned its closest mode.
+	 *  Defined in hierarchical.cpp.
+	 */
+	bool hierarchicalFAMS(int step);
+
 	/* save to file as %g: modes for all starting points or the pruned ones */
 	void saveModes(const std::string& filename, bool pruned);
 	/* save to multi_img: modes for all starting points or the pruned ones */
@@ -159,8 +173,20 @@ public:
 
 	KLResult FindKL();
 	void ComputeRealBandwidths(unsigned int h);
-	int64 DoFindKLIteration(int K, int L, float* scores);
-	void ComputeScores(float* scores, LSHReader &lsh, int L);
+	// seed: LSH random seed, see LSH::LSH(); safe to run concurrently
+	int64 DoFindKLIteration(int K, int L, float* scores, unsigned int seed = 0);
+	void ComputeScores(float* scores, LSHReader &lsh, int L) const;
+
+	// number of input samples represented by point i
+	inline unsigned int multiplicity(size_t i) const
+	{
+		return (pointCounts.empty() ? 1 : pointCounts[i]);
+	}
+	// number of input samples, differs from n_ if points were merged
+	inline size_t samples() const
+	{
+		return (pixelPoints.empty() ? n_ : pixelPoints.size());
+	}
 
 	// returns 2D intensity image containing segment indices
 	cv::Mat1s segmentImage() const;
@@ -185,7 +211,7 @@ public:
 	};
 
 	// distance in L1 between two data elements
-	inline unsigned int DistL1(Point& in_pt1, Point& in_pt2) const
+	inline unsigned int DistL1(const Point& in_pt1, const Point& in_pt2) const
 	{
 		size_t i = 0;
 		unsigned int ret = 0;
@@ -266,6 +292,14 @@ protected:
 	findClosest(const Mode &mode, const std::vector<MergedMode> &foomodes);
 	void trimModes(std::vector<MergedMode> &foomodes, int npmin, bool sp,
 				   size_t allowance = std::numeric_limits<size_t>::max());
+	// assign closest of modes to each point (prunedIndex)
+	void assignModes();
+	// number of samples the starting point of mode cm stands for
+	inline int modeSize(size_t cm) const
+	{
+		// merged points imply that all points are starting points
+		return (spsizes.empty() ? (int)multiplicity(cm) : spsizes[cm]);
+	}
 
 	// interval of input data
 	float minVal_, maxVal_;
@@ -276,6 +310,11 @@ protected:
 	// input data, in case we need to store it ourselves
 	std::vector<std::vector<unsigned short> > dataholder;
 
+	// multiplicity of each point if identical spectra were merged, or empty
+	std::vector<unsigned int> pointCounts;
+	// point index of each pixel if identical spectra were merged, or empty
+	std::vector<unsigned int> pixelPoints;
+
 	// selected points on which MS is run
 	std::vector<Point*> startPoints;
 
@@ -10,7 +10,7 @@ FAMS::MergedMode::MergedMode(const FAMS::Mode &d, int m, int spm)
 	: members(m), spmembers(spm), data(d.data.size()), valid(true)
 	{
 		for (size_t i = 0; i < data.size(); ++i)
-			data[i] = d.data[i];
+			data[i] = (float)d.data[i] * m;
 }
 
 std::vector<unsigned short> FAMS::MergedMode::normalized() const
@@ -29,12 +29,12 @@ double FAMS::MergedMode::distTo(const Mode &m) const
 	return ret;
 }
 
-void FAMS::MergedMode::add(const Mode &m, int sp)
+void FAMS::MergedMode::add(const Mode &m, int sp, int count)
 {
 	for (size_t i = 0; i < data.size(); ++i)
-		data[i] += m.data[i];
+		data[i] += (float)m.data[i] * count;
 
-	members++;
+	members += count;
 	spmembers += sp;
 }
 
@@ -106,8 +106,7 @@ void FAMS::pruneModes()
 
 	// set first mode
 	std::vector<MergedMode> foomodes;
-	foomodes.push_back(MergedMode(modes[0], 1,
-					   (spsizes.empty() ? 1 : spsizes[0])));
+	foomodes.push_back(MergedMode(modes[0], multiplicity(0), modeSize(0)));
 
 	int invalid = 0; // for statistics on invalidated modes
 
@@ -126,10 +125,10 @@ void FAMS::pruneModes()
 			int index = closest.second;
 
 			// merge into mode
-			foomodes[index].add(modes[cm], (spsizes.empty() ? 1 : spsizes[cm]));
+			foomodes[index].add(modes[cm], modeSize(cm), multiplicity(cm));
 		} else { // out of range, assume a new mode
-			foomodes.push_back(MergedMode(modes[cm], 1,
-									   (spsizes.empty() ? 1 : spsizes[cm])));
+			foomodes.push_back(MergedMode(modes[cm], multiplicity(cm),
+										  modeSize(cm)));
 		}
 
 		// when mode count gets overboard, invalidate modes with few members
@@ -168,7 +167,7 @@ void FAMS::pruneModes()
 		int index = closest.second;
 
 		// merge into mode
-		foomodes[index].add(modes[cm], (spsizes.empty() ? 1 : spsizes[cm]));
+		foomodes[index].add(modes[cm], modeSize(cm), multiplicity(cm));
 	}
 
 	/* Trim modes, second time */
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include "modules.h"
 #include "command.h"
+#include <trace.h>
 
 using namespace std;
 using namespace boost::program_options;
@@ -151,6 +152,13 @@ int main(int argc, char *argv[]) {
 	if (!c || !parse_opts(argc, argv, c, single)) return 1;
 	if (c->getConfig().verbosity > 0)
 		printVoleOnce();
-	return c->execute();	// all command destructors are called here
+	Trace::startFromEnvironment();
+	int ret;
+	{
+		TRACE_SPAN(c->getName().c_str(), "command");
+		ret = c->execute();
+	}
+	Trace::stopAndWrite();
+	return ret;	// all command destructors are called here
 }
 
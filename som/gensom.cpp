@@ -2,6 +2,7 @@
 #include "isosom.h"
 
 #include <progress_observer.h>
+#include <multi_img/colortransform.h>
 
 #include <similarity_measure.h>
 #include <sm_factory.h>
@@ -439,9 +440,10 @@ multi_img GenSOM::img(const std::vector<multi_img_base::BandDesc> &meta,
 cv::Mat3f GenSOM::bgr(const std::vector<multi_img_base::BandDesc> &meta,
 					  multi_img_base::Value maxval)
 {
+	ColorTransform transform(meta, maxval);
 	cv::Mat3f ret(size2D());
 	for (size_t i = 0; i < neurons.size(); ++i) {
-		ret(getCoord2D(i)) = multi_img::bgr(neurons[i], meta, maxval);
+		ret(getCoord2D(i)) = transform.bgr(neurons[i]);
 	}
 	return ret;
 }